@@ -0,0 +1,99 @@
+#ifndef APU_H
+#define APU_H
+
+#include <vector>
+
+#include <blip.h>
+
+class audio_ring;
+class cpu;
+
+// DMG audio: two square channels (the first with frequency sweep), the wave channel and the
+// noise channel, mixed through NR50/NR51. The APU is lazy; it only catches up to the cpu when
+// one of its registers is written or run_until() is called. Every change in a channel's output
+// level becomes a delta in a band-limited stereo buffer, and finished samples are pushed to out.
+class apu {
+    public:
+        static const unsigned int clock_rate = 4194304;
+
+        cpu* c;
+        audio_ring* out = nullptr;
+        unsigned int sample_rate;
+
+        // Stereo samples that didn't fit in out.
+        unsigned long long samples_dropped = 0;
+
+        apu(cpu* c, unsigned int sample_rate);
+
+        // Handles a CPU write to 0xFF10-0xFF3F.
+        void write(unsigned short addr, unsigned char value);
+
+        // Takes the registers already in memory as the APU's own state, e.g. the post-boot
+        // state load_rom leaves without a boot ROM (powered, channel 1 on). The constructor does
+        // this; call it again after loading another ROM.
+        void load_registers();
+
+        // Emulates up to cpu cycle time and pushes any finished samples to out.
+        void run_until(unsigned long long time);
+
+        // Produces ratio times as many samples per emulated second from now on.
+        void set_rate_adjust(double ratio);
+
+    private:
+        struct channel {
+            bool enabled = false;
+            bool dac = false;
+
+            unsigned int length = 0;
+            bool length_enable = false;
+
+            unsigned int volume = 0;
+            bool env_add = false;
+            unsigned int env_period = 0;
+            unsigned int env_timer = 0;
+
+            unsigned int freq = 0;
+            unsigned int period = 8192;
+            unsigned long long next_tick = 0;
+            unsigned int phase = 0;
+
+            unsigned int duty = 0;
+            unsigned int volume_code = 0;
+            unsigned int lfsr = 0x7FFF;
+            bool narrow = false;
+
+            unsigned int sweep_period = 0;
+            unsigned int sweep_shift = 0;
+            bool sweep_negate = false;
+            unsigned int sweep_timer = 0;
+            bool sweep_enabled = false;
+            unsigned int shadow_freq = 0;
+
+            int out_left = 0;
+            int out_right = 0;
+        };
+
+        channel ch[4];
+        bool power = false;
+
+        unsigned long long time;
+        unsigned long long frame_start;
+        unsigned long long next_sequencer;
+        unsigned int sequencer_step = 0;
+
+        blip_buffer left;
+        blip_buffer right;
+        std::vector<short> scratch;
+
+        void run_channels(unsigned long long end);
+        void clock_sequencer();
+        void trigger(unsigned int i);
+        void update_period(unsigned int i);
+        unsigned int sweep_target();
+        unsigned int channel_level(unsigned int i) const;
+        void update_output(unsigned int i, unsigned long long t);
+        void update_status();
+        void flush();
+};
+
+#endif
\ No newline at end of file
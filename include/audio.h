@@ -0,0 +1,44 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <atomic>
+#include <SDL2/SDL.h>
+
+class audio_ring;
+
+// SDL audio output. The device callback runs on SDL's audio thread and only ever reads from
+// the ring; when the ring runs dry it repeats the last sample pair instead of clicking to zero.
+class audio {
+    public:
+        SDL_AudioDeviceID device = 0;
+        SDL_AudioSpec spec;
+        audio_ring* ring;
+
+        // Callbacks that found fewer samples in the ring than they needed.
+        std::atomic<unsigned long long> underruns{0};
+
+        // Depth, in stereo frames, that pace() keeps the ring at.
+        unsigned int target_frames;
+
+        audio(audio_ring* ring, unsigned int sample_rate, unsigned int buffer_frames);
+        ~audio();
+
+        bool open();
+        void close();
+
+        // Called once per emulated frame. Returns the resampling ratio (within +-0.5%) that
+        // steers the ring's depth back to target_frames, below 1 while emulation runs ahead.
+        // Sleeps while the ring holds more than target_frames, so the sound card's clock paces
+        // emulation.
+        double pace();
+
+    private:
+        unsigned int sample_rate;
+        unsigned int buffer_frames;
+        short last[2] = { 0, 0 };
+        double depth_average = 0;
+
+        static void callback(void* userdata, Uint8* stream, int len);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,63 @@
+#ifndef AUDIO_RING_H
+#define AUDIO_RING_H
+
+#include <atomic>
+#include <vector>
+
+// Single-producer/single-consumer queue of interleaved stereo samples between the emulation
+// thread and the SDL audio callback. Neither side ever waits: write() drops what doesn't fit
+// and read() returns what is there.
+class audio_ring {
+    public:
+        audio_ring(unsigned int capacity) {
+            unsigned int size = 1;
+            while (size < capacity) size <<= 1;
+
+            data.resize(size);
+            mask = size - 1;
+        }
+
+        // Producer side.
+        unsigned int write(const short* samples, unsigned int count) {
+            unsigned int h = head.load(std::memory_order_relaxed);
+            unsigned int t = tail.load(std::memory_order_acquire);
+
+            unsigned int space = static_cast<unsigned int>(data.size()) - (h - t);
+            if (count > space) count = space;
+
+            for (unsigned int i = 0; i < count; i++) data[(h + i) & mask] = samples[i];
+            head.store(h + count, std::memory_order_release);
+            return count;
+        }
+
+        // Consumer side.
+        unsigned int read(short* samples, unsigned int count) {
+            unsigned int t = tail.load(std::memory_order_relaxed);
+            unsigned int h = head.load(std::memory_order_acquire);
+
+            if (count > h - t) count = h - t;
+
+            for (unsigned int i = 0; i < count; i++) samples[i] = data[(t + i) & mask];
+            tail.store(t + count, std::memory_order_release);
+            return count;
+        }
+
+        // Samples currently queued; exact on either side, approximate from anywhere else.
+        unsigned int size() const {
+            return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+        }
+
+        unsigned int capacity() const {
+            return static_cast<unsigned int>(data.size());
+        }
+
+    private:
+        std::vector<short> data;
+        unsigned int mask;
+
+        // Kept on separate cache lines so the two threads don't false-share.
+        alignas(64) std::atomic<unsigned int> head{0};
+        alignas(64) std::atomic<unsigned int> tail{0};
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,57 @@
+#ifndef BLIP_H
+#define BLIP_H
+
+#include <vector>
+
+// Band-limited step synthesis. Callers describe a waveform as amplitude changes (deltas) at
+// clock times; each delta is stamped into the output as a windowed-sinc step at the output
+// sample rate, so the APU never has to run a filter at 4 MHz and square waves don't alias.
+class blip_buffer {
+    public:
+        static const int phase_bits = 5;
+        static const int phases = 1 << phase_bits;
+        static const int width = 16;
+
+        blip_buffer(double clock_rate, double sample_rate, unsigned int max_samples);
+
+        // Changes the clock-to-sample ratio, e.g. for small rate corrections. Deltas already
+        // added keep their positions.
+        void set_rates(double clock_rate, double sample_rate);
+
+        // Adds an amplitude change at time clocks after the start of the current frame.
+        inline void add_delta(unsigned int time, int delta) {
+            unsigned long long pos = offset + time * factor;
+            unsigned int index = static_cast<unsigned int>(pos >> 32);
+            const float* k = kernel[(pos >> (32 - phase_bits)) & (phases - 1)];
+
+            float* out = &buf[index];
+            for (int i = 0; i < width; i++) out[i] += delta * k[i];
+        }
+
+        // Ends the current frame after clocks; the samples it covers become readable.
+        void end_frame(unsigned int clocks);
+
+        // Largest frame, in clocks, that still fits in the buffer.
+        unsigned int max_frame_clocks() const;
+
+        unsigned int samples_avail() const;
+
+        // Reads up to count samples, writing every stride-th short of out.
+        unsigned int read_samples(short* out, unsigned int count, unsigned int stride);
+
+    private:
+        // Step response derivative for each of the sub-sample phases; per instance so
+        // several emulators can be built on different threads.
+        float kernel[phases][width];
+
+        std::vector<float> buf;
+        unsigned long long factor;
+        unsigned long long offset = 0;
+
+        float integrator = 0;
+        float highpass = 0;
+
+        void build_kernel();
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,70 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Records finished 160x144 frames on a background encoder thread. push() copies the frame into
+// the next buffer of a preallocated pool and returns; the encoder converts and writes pooled
+// frames in order. When the encoder falls behind and every buffer is full, push() drops the
+// frame and counts it instead of waiting, so capture never stalls emulation.
+class frame_capture {
+    public:
+        enum format { y4m, raw, png, pipe };
+
+        static const unsigned int pixels = 160 * 144;
+
+        std::atomic<unsigned long long> captured{0};
+        std::atomic<unsigned long long> dropped{0};
+
+        frame_capture();
+        ~frame_capture();
+
+        // target picks the output from its form:
+        //   "out.y4m"          YUV4MPEG2 (4:4:4) video
+        //   "out.rgb"          raw RGB24 frames back to back
+        //   "dir/frame.png"    dir/frame000000.png, dir/frame000001.png, ...
+        //   "|command args"    raw RGB24 piped into command's stdin (e.g. ffmpeg)
+        bool start(const char* target, unsigned int buffers = 16);
+
+        // Emulation thread only. frame is ARGB8888, pitch pixels apart.
+        void push(const unsigned int* frame, unsigned int pitch);
+
+        // Encodes whatever is still queued, then closes the output.
+        void stop();
+
+        // Set when a write fails, e.g. the capture command exited; no frames are taken after.
+        std::atomic<bool> failed{false};
+
+    private:
+        format kind = raw;
+        std::string path;
+        FILE* out = nullptr;
+
+        // Frame n goes in pool slot n % slots. head counts frames pushed and tail frames
+        // encoded; frames [tail, head) belong to the encoder, and push() only fills a slot when
+        // fewer than slots frames are queued.
+        std::vector<unsigned int> pool;
+        unsigned int slots = 0;
+        alignas(64) std::atomic<unsigned long long> head{0};
+        alignas(64) std::atomic<unsigned long long> tail{0};
+
+        std::thread encoder;
+        std::mutex wake_lock;
+        std::condition_variable wake;
+        std::atomic<bool> stopping{false};
+        std::atomic<bool> idle{false};
+
+        std::vector<unsigned char> scratch;
+
+        void run();
+        bool encode(const unsigned int* frame, unsigned long long number);
+        bool write_png(const unsigned int* frame, unsigned long long number);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef CHEATS_H
+#define CHEATS_H
+
+#include <vector>
+
+class cpu;
+
+// Game Genie ROM patches and GameShark / freeze RAM writes. Memory accesses never check for
+// cheats: a ROM patch is written into its 256-byte page of the mapped ROM, with the original
+// page kept so codes can be removed and compare values checked against unpatched bytes, and
+// RAM codes are a flat list written once per frame by apply_frame().
+class cheats {
+    public:
+        cpu* c;
+
+        cheats(cpu* c);
+
+        // Accepts Game Genie "ABC-DEF" or "ABC-DEF-GHI" (with a compare value), GameShark
+        // "TTVVAAAA" (type, value, address low byte first) and freeze "AAAA=VV", all hex.
+        bool add(const char* code);
+
+        // Adds every code in a file, one per line; '#' starts a comment.
+        bool load(const char* path);
+
+        // Removes every code and restores the original ROM bytes.
+        void clear();
+
+        // Writes the RAM values. Called once per frame, before it runs.
+        inline void apply_frame() {
+            for (const ram_write& w : writes) *target(w) = w.value;
+        }
+
+    private:
+        struct rom_patch {
+            unsigned short addr;
+            unsigned char value;
+            bool has_compare;
+            unsigned char compare;
+        };
+
+        struct rom_page {
+            unsigned short base;
+            unsigned char original[256];
+        };
+
+        // bank is the CGB WRAM bank for 0xD000-0xDFFF, or 0 for "whatever is mapped".
+        struct ram_write {
+            unsigned short addr;
+            unsigned char value;
+            unsigned char bank;
+        };
+
+        std::vector<rom_patch> patches;
+        std::vector<rom_page> pages;
+        std::vector<ram_write> writes;
+
+        bool add_game_genie(const char* code);
+        void patch_rom();
+        unsigned char* target(const ram_write& w);
+};
+
+#endif
\ No newline at end of file
@@ -1,60 +1,269 @@
 #ifndef CPU_H
 #define CPU_H
 
+#include <cstring>
+
+class apu;
+class debugger;
+class profiler;
+class serial;
+class trace_buffer;
+
 class cpu {
     public:
         bool running = true;
         
         // fuck you
         unsigned char mram[1500000];
-        unsigned char vram[1500000];
+
+        // CGB banked memory. The selected VRAM bank and WRAM bank 1-7 live in mram at 0x8000 and
+        // 0xD000 like everything else; switching banks swaps 8 KB / 4 KB blocks with these
+        // stores, so the CPU's memory accesses stay plain array accesses.
+        unsigned char vram[2 * 0x2000];
+        unsigned char wram[8 * 0x1000];
+
+        // CGB palette RAM: 8 palettes of 4 little-endian RGB555 colours each.
+        unsigned char bg_palette[64];
+        unsigned char obj_palette[64];
+
+        // Set by load_rom() when the cartridge header asks for CGB features.
+        bool cgb = false;
+        bool double_speed = false;
+        unsigned int vram_select = 0;
+        unsigned int wram_select = 1;
+
+        // HBlank HDMA in progress: next source and destination, and 16-byte blocks left.
+        bool hdma_active = false;
+        unsigned short hdma_src = 0;
+        unsigned short hdma_dst = 0;
+        unsigned int hdma_blocks = 0;
+
+        // CPU cycles the HBlank HDMA has stalled the CPU for, charged to the next instruction.
+        unsigned int dma_stall = 0;
+
+        // OAM DMA. The 160 bytes are copied when 0xFF46 is written; the system clock window
+        // [oam_dma_start, oam_dma_end) is when the transfer would still own the bus, and CPU
+        // data accesses inside it see the conflicts the hardware has.
+        unsigned long long oam_dma_start = 0;
+        unsigned long long oam_dma_end = 0;
+        unsigned short oam_dma_source = 0;
+
+        // Data accesses go through the checked path while cycles is below this: during OAM DMA,
+        // and always while a debugger has watchpoints. Otherwise they cost one compare.
+        unsigned long long checked_until = 0;
+
+        // Optional boot ROM: 0x100 bytes for DMG, 0x900 for CGB. While mapped it covers the
+        // cartridge at 0x0000-0x00FF (and 0x0200-0x08FF for CGB), like on hardware, until the
+        // game writes 0xFF50.
+        unsigned char boot_rom[0x900];
+        unsigned int boot_rom_size = 0;
+        bool boot_rom_mapped = false;
 
         unsigned int width = 160;
         unsigned int height = 144;
         unsigned int size_modifier = 5;
 
+        // prog_counter_copy holds the address of the instruction read() is executing.
         unsigned short prog_counter = 0x0000;
         unsigned short prog_counter_copy = 0x0000;
 
         unsigned short stack[256];
         unsigned short stack_pointer = 0x00;
 
+        // Total 4 MHz system clocks and instructions executed, the cost of the instruction
+        // currently in read() in CPU T-cycles, and in system clocks (half as many in double
+        // speed). The PPU and APU run off the system clock.
+        unsigned long long cycles = 0;
+        unsigned long long instructions = 0;
+        unsigned int step_cycles = 0;
+        unsigned int step_clocks = 0;
+
+        // Opcodes read() has no handler for yet. Each is also printed unless report_unknown is
+        // cleared, as batch tools do.
+        unsigned long long unknown_opcodes = 0;
+        bool report_unknown = true;
+
+        // Number of 16 KB banks in the loaded cartridge, and the bank mapped at 0x4000.
+        unsigned int rom_banks = 2;
+        unsigned int rom_bank = 1;
+
+        // Number of CPU writes that went through the IO register handler (0xFF00-0xFF7F, 0xFFFF).
+        unsigned long long io_writes = 0;
+
+        // Sound unit that owns 0xFF10-0xFF3F, and serial port that owns 0xFF01-0xFF02, if any.
+        apu* sound = nullptr;
+        serial* port = nullptr;
+
+        // Optional per-PC profile and execution trace; nothing is recorded while these are null.
+        profiler* prof = nullptr;
+        trace_buffer* tracer = nullptr;
+
+        // Breakpoints and watchpoints. Call update_access_checks() after attaching or detaching.
+        debugger* debug = nullptr;
+
+        // The two halves of each pair sit next to each other in host byte order, so a pair is
+        // one 16-bit load or store. Either way the pairs are AF, BC, DE, HL, two bytes each.
+        // F holds the flags in bits 7-4 (Z, N, H, CY); its low nibble is always 0.
         struct {
-            unsigned char a;
-            unsigned char b;
-            unsigned char c;
-            unsigned char d;
-
-            unsigned char e;
-            unsigned char f;
-            unsigned char h;
-            unsigned char l;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            unsigned char a, f;
+            unsigned char b, c;
+            unsigned char d, e;
+            unsigned char h, l;
+#else
+            unsigned char f, a;
+            unsigned char c, b;
+            unsigned char e, d;
+            unsigned char l, h;
+#endif
         } registers;
 
-        struct {
-            bool f_zero = false;
-            bool f_subtract = false;
-            bool f_half_carry = false;
-            bool f_carry = false;
-        } f_flags;
+        // Everything read() changes, for run-ahead. Only the 64K address space and the CGB bank
+        // stores are copied; the rest of mram is the linear ROM image, which no write can
+        // reach. Host-side counters (instructions, io_writes, unknown_opcodes) and the attached
+        // devices are not part of it.
+        struct state {
+            decltype(registers) regs;
+            unsigned short prog_counter;
+            unsigned short prog_counter_copy;
+            unsigned short stack_pointer;
+            unsigned short stack[256];
+            unsigned long long cycles;
+            unsigned int step_cycles;
+            unsigned int rom_bank;
+            bool running;
+            unsigned char memory[0x10000];
+
+            unsigned char vram[2 * 0x2000];
+            unsigned char wram[8 * 0x1000];
+            unsigned char bg_palette[64];
+            unsigned char obj_palette[64];
+            bool double_speed;
+            unsigned int vram_select;
+            unsigned int wram_select;
+            bool hdma_active;
+            unsigned short hdma_src;
+            unsigned short hdma_dst;
+            unsigned int hdma_blocks;
+            unsigned int dma_stall;
+            unsigned long long oam_dma_start;
+            unsigned long long oam_dma_end;
+            unsigned short oam_dma_source;
+            bool boot_rom_mapped;
+        };
 
         cpu();
 
+        void save_state(state& s) const;
+        void load_state(const state& s);
+
+        bool load_boot_rom(const char* path);
         bool load_rom(const char* rom);
+
+        // Starts the loaded cartridge: at 0x0000 in the boot ROM if one was loaded, otherwise
+        // straight at 0x0100 with the registers and IO the boot ROM would have left behind.
+        // load_rom() calls this.
+        void power_on();
+
+        // Where the cartridge byte at addr (below 0x8000) is kept: in mram, or in the saved copy
+        // while the boot ROM covers it. ROM patches go through this so they survive the unmap.
+        unsigned char* cart_byte(unsigned short addr);
+
+        // Clears the clock and the timing state a run leaves behind (OAM DMA and HDMA windows,
+        // stalls, double speed), for reusing one cpu across runs. Memory and the CGB bank
+        // selects that map it, registers, host-side counters and attached devices are left alone.
+        void reset();
+
         void read();
+        void record_trace(unsigned short pc);
+
+        // CPU-side data read. Outside an OAM DMA window, and with no watchpoints, this is a
+        // plain array access. Instruction fetches don't come through here; games run their DMA
+        // wait loop from HRAM, which the DMA never blocks.
+        inline unsigned char read_byte(unsigned short addr) {
+            if (cycles < checked_until) return checked_read(addr);
+            return mram[addr];
+        }
+
+        // 0xFF00-0xFF7F and IE (0xFFFF). HRAM in between is plain memory.
+        static inline bool is_io(unsigned short addr) {
+            return addr >= 0xFF00 && (addr < 0xFF80 || addr == 0xFFFF);
+        }
+
+        // CPU-side memory write. Memory, HRAM included, is a plain store; IO registers go
+        // through io_write() so devices can react to them.
+        inline void write_byte(unsigned short addr, unsigned char value) {
+            if (cycles < checked_until) checked_write(addr, value);
+            else if (is_io(addr)) io_write(addr, value);
+            else mram[addr] = value;
+        }
+
+        void update_access_checks();
+
+        void io_write(unsigned short addr, unsigned char value);
+
+        // VRAM bank 0 or 1 as 0x2000 bytes from 0x8000, wherever it currently lives.
+        inline const unsigned char* vram_bank(unsigned int bank) const {
+            return bank == vram_select ? &mram[0x8000] : &vram[bank * 0x2000];
+        }
+
+        // Copies the next 16-byte HBlank HDMA block; the PPU calls this on entering HBlank.
+        void hblank_dma();
+
+        inline unsigned short get_af() const { return load_pair(pair_af); }
+        inline unsigned short get_bc() const { return load_pair(pair_bc); }
+        inline unsigned short get_de() const { return load_pair(pair_de); }
+        inline unsigned short get_hl() const { return load_pair(pair_hl); }
+
+        inline void set_af(unsigned short sh_af) { store_pair(pair_af, sh_af & 0xFFF0); }
+        inline void set_bc(unsigned short sh_bc) { store_pair(pair_bc, sh_bc); }
+        inline void set_de(unsigned short sh_de) { store_pair(pair_de, sh_de); }
+        inline void set_hl(unsigned short sh_hl) { store_pair(pair_hl, sh_hl); }
+
+        inline bool f_zero() const { return registers.f & 0x80; }
+        inline bool f_subtract() const { return registers.f & 0x40; }
+        inline bool f_half_carry() const { return registers.f & 0x20; }
+        inline bool f_carry() const { return registers.f & 0x10; }
+
+        // Packs all four flags into F without branching.
+        inline void set_f(bool fz, bool fs, bool fh, bool fcy) {
+            registers.f = static_cast<unsigned char>(fz << 7 | fs << 6 | fh << 5 | fcy << 4);
+        }
+
+        inline void set_f_carry(bool fcy) {
+            registers.f = static_cast<unsigned char>((registers.f & 0xE0) | fcy << 4);
+        }
+
+    private:
+        unsigned char checked_read(unsigned short addr);
+        void checked_write(unsigned short addr, unsigned char value);
+        unsigned char dma_conflict_read(unsigned short addr);
+        void dma_conflict_write(unsigned short addr, unsigned char value);
+        unsigned int bus_of(unsigned short addr) const;
+        void oam_dma(unsigned char page);
+
+        void select_vram(unsigned int bank);
+        void select_wram(unsigned int bank);
+        void dma_block_copy(unsigned int blocks);
+        void palette_write(unsigned short addr, unsigned char value);
+
+        // Cartridge bytes hidden by the boot ROM while it is mapped.
+        unsigned char cart_head[0x900];
+
+        void map_boot_rom(bool mapped);
+        void post_boot_state();
 
-        short get_af();
-        short get_bc();
-        short get_de();
-        short get_hl();
+        enum pair { pair_af, pair_bc, pair_de, pair_hl };
 
-        void set_af(unsigned short sh_af);
-        void set_bc(unsigned short sh_bc);
-        void set_de(unsigned short sh_de);
-        void set_hl(unsigned short sh_hl);
+        inline unsigned short load_pair(pair p) const {
+            unsigned short value;
+            memcpy(&value, reinterpret_cast<const unsigned char*>(&registers) + 2 * p, 2);
+            return value;
+        }
 
-        void set_f(bool fz, bool fs, bool fh, bool fcy);
-        void build_f();
+        inline void store_pair(pair p, unsigned short value) {
+            memcpy(reinterpret_cast<unsigned char*>(&registers) + 2 * p, &value, 2);
+        }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,100 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <string>
+#include <vector>
+
+class cpu;
+
+// Breakpoints and watchpoints. Breakpoints are one bit per address in a 64K-bit execute map,
+// checked against the next PC after each instruction, and by arrive() when execution starts or
+// is moved. Watchpoints mark the 256-byte pages they
+// cover; while any exist the cpu sends its data accesses here, and only accesses to a marked
+// page look at the watchpoint list. The cpu does none of this unless cpu::debug is set.
+class debugger {
+    public:
+        enum stop_reason { none, breakpoint, step, watch_read, watch_write, interrupt };
+
+        // Watchpoint kinds, as a mask.
+        static const unsigned int reads = 1;
+        static const unsigned int writes = 2;
+
+        cpu* c;
+
+        // Why execution stopped, if it did: the caller stops calling cpu::read() until
+        // resume(). stop_addr is the next PC for breakpoints and steps and the data address
+        // for watchpoints; stop_pc is the instruction that caused the stop.
+        stop_reason stopped = none;
+        unsigned short stop_addr = 0;
+        unsigned short stop_pc = 0;
+
+        // Stop after the next instruction.
+        bool single_step = false;
+
+        // Stops between instructions at the current PC, e.g. when a remote debugger attaches.
+        void halt();
+
+        debugger(cpu* c);
+
+        void add_breakpoint(unsigned short addr);
+        void remove_breakpoint(unsigned short addr);
+
+        inline bool has_breakpoint(unsigned short addr) const {
+            return (exec_map[addr >> 6] >> (addr & 63)) & 1;
+        }
+
+        // Watches length bytes from addr for the given kinds; removing takes the same
+        // arguments. Both refresh the cpu's access checks.
+        void add_watchpoint(unsigned short addr, unsigned int length, unsigned int kind);
+        void remove_watchpoint(unsigned short addr, unsigned int length, unsigned int kind);
+
+        bool watching() const { return !watches.empty(); }
+
+        inline bool page_watched(unsigned short addr, unsigned int kind) const {
+            return (watched_pages[addr >> 8] & kind) != 0;
+        }
+
+        // Called by the cpu after each instruction with the PC of the next one.
+        inline void after_instruction(unsigned short pc) {
+            if (stopped != none) return;
+            if (single_step || has_breakpoint(pc)) {
+                stopped = single_step ? step : breakpoint;
+                stop_addr = pc;
+                stop_pc = pc;
+                single_step = false;
+            }
+        }
+
+        // Stops at pc before it runs if it has a breakpoint. after_instruction() only sees the
+        // PC an instruction leads to, so call this for the first PC and when the PC is set.
+        inline void arrive(unsigned short pc) {
+            if (stopped != none || !has_breakpoint(pc)) return;
+            stopped = breakpoint;
+            stop_addr = pc;
+            stop_pc = pc;
+            single_step = false;
+        }
+
+        // Called by the cpu for an access of the given kind to a watched page.
+        void check_access(unsigned short addr, unsigned int kind);
+
+        void resume();
+
+        // One line for the current stop: reason, address, the instruction and the registers.
+        std::string describe() const;
+
+    private:
+        struct watch {
+            unsigned short addr;
+            unsigned int length;
+            unsigned int kind;
+        };
+
+        unsigned long long exec_map[0x10000 / 64];
+        unsigned char watched_pages[256];
+        std::vector<watch> watches;
+
+        void update_pages();
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,15 @@
+#ifndef DISASM_H
+#define DISASM_H
+
+#include <string>
+
+// Formats the instruction starting at bytes[0], which was fetched from address pc. Operand
+// placeholders in the opcode table's mnemonic (d8, d16, a8, a16, s8) are replaced with their
+// values; relative jumps show their target address. bytes must hold at least the instruction's
+// length from opcode_table.
+std::string disassemble(unsigned short pc, const unsigned char* bytes);
+
+// Length in bytes of the instruction starting at bytes[0].
+unsigned int instruction_length(const unsigned char* bytes);
+
+#endif
\ No newline at end of file
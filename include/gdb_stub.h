@@ -0,0 +1,58 @@
+#ifndef GDB_STUB_H
+#define GDB_STUB_H
+
+#include <string>
+
+#include <net.h>
+
+class cpu;
+class debugger;
+
+// GDB remote serial protocol server for the SM83 core, on a TCP or Unix socket (see net.h).
+// Registers are af, bc, de, hl, sp and pc, 16 bits each, described to the client through
+// target.xml. While the game runs the stub costs one non-blocking socket check per frame;
+// once it has stopped, serve() answers packets until the client continues or steps.
+// Breakpoints, watchpoints and stepping are the attached debugger's.
+class gdb_stub {
+    public:
+        cpu* c;
+        debugger* debug;
+
+        gdb_stub(cpu* c, debugger* debug);
+        ~gdb_stub();
+
+        bool listen(const char* address);
+
+        // Called once per frame while running: takes a new client, which halts the game, and
+        // notices the client's interrupt (Ctrl-C). Either way it then serves until resumed.
+        void poll();
+
+        bool attached() const { return client != net_invalid; }
+
+        // Reports the debugger's current stop to the client and answers packets until it
+        // continues, steps or detaches.
+        void serve();
+
+    private:
+        net_socket listener = net_invalid;
+        net_socket client = net_invalid;
+        bool acks = true;
+        std::string input;
+
+        void drop_client();
+        void answer();
+        bool read_packet(std::string& packet);
+        void send_packet(const std::string& data);
+        std::string stop_reply() const;
+
+        // Returns false when the packet resumes execution.
+        bool handle(const std::string& packet);
+
+        std::string read_registers() const;
+        void write_register(unsigned int index, unsigned int value);
+        std::string read_memory(unsigned int addr, unsigned int length) const;
+        void write_memory(unsigned int addr, const std::string& hex);
+        bool change_point(bool insert, unsigned long type, unsigned long addr, unsigned long length);
+};
+
+#endif
\ No newline at end of file
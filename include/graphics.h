@@ -1,26 +1,79 @@
 #ifndef GRAPHICS_H
 #define GRAPHICS_H
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <SDL2/SDL.h>
 
+class scaler;
+class triple_buffer;
+
+// The window and input stay on the main thread. Rendering runs on a separate present thread
+// that owns the SDL_Renderer and texture, so vsync and driver stalls never block emulation.
 class graphics {
     public:
         SDL_Window* window;
-        SDL_Renderer* renderer;
-        SDL_Texture* texture;
+        SDL_Renderer* renderer = nullptr;
+        SDL_Texture* texture = nullptr;
         SDL_Event event;
 
         unsigned int width;
         unsigned int height;
         unsigned int size_modifier;
 
+        // Optional CPU-side upscaler, set before the renderer starts. The texture is then
+        // scale->factor times the frame size and frames can't be composed into it directly.
+        scaler* scale = nullptr;
+
+        // Written by the present thread.
+        std::atomic<unsigned long long> texture_uploads{0};
+        std::atomic<unsigned long long> frames_presented{0};
+
         graphics(unsigned int width, unsigned int height, unsigned int size_modifier, const char* title);
         ~graphics();
 
         bool fetch_input();
-        void update_graphics();
+
+        // Resizes the window to size_modifier times the frame. Call before the renderer starts.
+        void set_size_modifier(unsigned int size_modifier);
+
+        // Starts the present thread, which shows the newest frame published to frames.
+        void start_presenting(triple_buffer* frames);
+
+        // Call after frames->publish(); wakes the present thread without waiting for it.
+        void frame_published();
+
+        // Direct mode, the alternative to the present thread: the renderer lives on the calling
+        // thread and the PPU composes straight into locked texture memory. lock_frame() returns
+        // that memory and its pitch in pixels (the texture stays locked until present_locked()),
+        // or nullptr when the renderer can't lock, in which case use update_graphics().
+        bool start_direct();
+        unsigned int* lock_frame(unsigned int& pitch);
+        void present_locked();
+        void update_graphics(const unsigned int* pixels);
+
         void end_graphics();
-        
+
+    private:
+        triple_buffer* frames = nullptr;
+        std::thread presenter;
+        std::mutex wake_lock;
+        std::condition_variable wake;
+        bool stopping = false;
+
+        bool lockable = true;
+        unsigned int* locked = nullptr;
+        unsigned int locked_pitch = 0;
+
+        std::vector<unsigned int> scaled;
+
+        unsigned int factor() const;
+        bool create_renderer(Uint32 flags);
+        void present_loop();
+        void present();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,28 @@
+#ifndef NET_H
+#define NET_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Thin blocking stream sockets for the link cable and the debugger. Addresses are either
+// "tcp:[host:]port" (host defaults to 127.0.0.1, and listeners only bind there unless a host
+// is given) or a Unix-domain socket path ("unix:/tmp/gb.sock" or just a path).
+typedef intptr_t net_socket;
+const net_socket net_invalid = -1;
+
+net_socket net_listen(const char* address);
+net_socket net_connect(const char* address);
+
+// With wait false it returns net_invalid straight away when nobody is connecting.
+net_socket net_accept(net_socket listener, bool wait = true);
+
+// Sends all of data; false once the peer has gone.
+bool net_send(net_socket s, const void* data, size_t size);
+
+// Receives up to size bytes. With wait false it returns 0 straight away when nothing is
+// queued. Returns -1 once the peer has gone.
+int net_recv(net_socket s, void* data, size_t size, bool wait);
+
+void net_close(net_socket s);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,64 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <atomic>
+#include <fstream>
+
+// Host-side performance counters for one emulator instance. The emulation thread keeps plain
+// counters while it runs and publishes them here once per frame with relaxed stores, so any
+// other thread can read a consistent-enough snapshot without locks and the hot loop never
+// touches an atomic.
+class perf {
+    public:
+        struct counters {
+            std::atomic<unsigned long long> instructions{0};
+            std::atomic<unsigned long long> frames{0};
+            std::atomic<unsigned long long> texture_uploads{0};
+            std::atomic<unsigned long long> io_writes{0};
+            std::atomic<unsigned long long> core_ns{0};
+            std::atomic<unsigned long long> sdl_ns{0};
+        };
+
+        struct snapshot {
+            unsigned long long instructions;
+            unsigned long long frames;
+            unsigned long long texture_uploads;
+            unsigned long long io_writes;
+            unsigned long long core_ns;
+            unsigned long long sdl_ns;
+        };
+
+        counters totals;
+
+        // Prints a stats line every stats_interval_ms of wall time; 0 disables it.
+        unsigned int stats_interval_ms = 0;
+
+        perf();
+        ~perf();
+
+        static unsigned long long now_ns();
+
+        // Streams Chrome trace events (chrome://tracing, Perfetto) to path, one "frame" span per
+        // frame with nested "core" and "sdl" spans.
+        bool open_trace(const char* path);
+
+        // Publishes one frame. core_start..core_end is time spent in cpu::read(), and
+        // core_end..sdl_end is time spent in SDL (input, texture upload, present).
+        void end_frame(unsigned long long instructions, unsigned long long texture_uploads, unsigned long long io_writes,
+            unsigned long long core_start, unsigned long long core_end, unsigned long long sdl_end);
+
+        snapshot read() const;
+
+    private:
+        std::ofstream trace;
+        bool trace_empty = true;
+        unsigned long long origin_ns;
+
+        unsigned long long last_stats_ns;
+        snapshot last_stats;
+
+        void trace_span(const char* name, unsigned long long start, unsigned long long end, unsigned long long instructions);
+        void print_stats(unsigned long long now);
+};
+
+#endif
\ No newline at end of file
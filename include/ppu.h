@@ -0,0 +1,88 @@
+#ifndef PPU_H
+#define PPU_H
+
+class cpu;
+
+// DMG and CGB picture processing unit. It runs off the system clocks the cpu reports after each
+// instruction, keeps LY, STAT and the mode timings in mram, raises the VBlank and STAT
+// interrupts in IF, and composes each visible line into framebuffer as ARGB8888 at the end of
+// mode 3.
+class ppu {
+    public:
+        cpu* c;
+
+        // Lines are composed into framebuffer, pitch pixels apart. It points at pixels unless
+        // the caller swaps in its own buffer (e.g. locked texture memory) between frames.
+        unsigned int* framebuffer;
+        unsigned int pitch = 160;
+        unsigned int pixels[160 * 144];
+
+        // Current mode (0 HBlank, 1 VBlank, 2 OAM scan, 3 transfer), the dot within the current
+        // 456-dot line, and the line being drawn.
+        unsigned int mode = 2;
+        unsigned int dots = 0;
+        unsigned int ly = 0;
+
+        // Set when the PPU enters VBlank; frame_rendered says whether that frame's pixels were
+        // composed. The caller clears frame_ready.
+        bool frame_ready = false;
+        bool frame_rendered = false;
+        unsigned long long frames = 0;
+
+        // Render-skip controls. Timing, registers and interrupts are identical either way; only
+        // pixel composition is skipped. With render_every = N, one frame in N is composed.
+        bool render_enabled = true;
+        unsigned int render_every = 1;
+
+        // Timing and mode state for run-ahead; framebuffer contents and the render settings
+        // are not included.
+        struct state {
+            unsigned int mode;
+            unsigned int dots;
+            unsigned int ly;
+            bool frame_ready;
+            bool frame_rendered;
+            unsigned long long frames;
+            bool lcd_on;
+            bool stat_line;
+            bool rendering_frame;
+            unsigned int window_line;
+            unsigned int next_event;
+        };
+
+        ppu(cpu* c);
+
+        void save_state(state& s) const;
+        void load_state(const state& s);
+
+        // Advances by cycles of the 4 MHz system clock (cpu::step_clocks).
+        void step(unsigned int cycles);
+        void render_scanline();
+
+    private:
+        bool lcd_on = false;
+        bool stat_line = false;
+        bool rendering_frame = true;
+        unsigned int window_line = 0;
+
+        // Dot at which the current mode next changes; step() returns early until then.
+        unsigned int next_event = 0;
+
+        // Objects on each visible line, at most 10, in drawing priority order (highest first).
+        // Built from a whole pass over OAM and reused until OAM, the object height or the
+        // priority mode differ from what they were built from.
+        unsigned char line_objects[144][10];
+        unsigned char line_count[144];
+        unsigned char built_oam[0xA0];
+        unsigned int built_height = 0;
+        bool built_cgb = false;
+
+        void set_mode(unsigned int m);
+        void update_stat();
+        void start_frame();
+        void render_scanline_cgb();
+        const unsigned char* objects_on_line(unsigned int height, unsigned int& count);
+        void build_object_lists(unsigned int height);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,59 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <vector>
+
+class cpu;
+
+// Per-instruction execution profile. Every (bank, PC) pair owns one slot in a flat array
+// sized once from the cartridge's bank count, so recording an instruction is two adds and
+// never allocates. The cpu only calls record() when a profiler is attached.
+class profiler {
+    public:
+        struct pc_stats {
+            unsigned long long count = 0;
+            unsigned long long cycles = 0;
+        };
+
+        // Slots are laid out as the ROM image (bank 0, then each switchable bank), followed
+        // by 0x8000-0xFFFF. A ROM slot index is therefore also that byte's offset in the ROM.
+        unsigned int rom_banks;
+        std::vector<pc_stats> stats;
+
+        profiler(unsigned int rom_banks);
+
+        inline unsigned int slot(unsigned short pc, unsigned int bank) const {
+            if (pc < 0x4000) return pc;
+            if (pc < 0x8000) return (bank % rom_banks) * 0x4000 + (pc - 0x4000);
+            return rom_banks * 0x4000 + (pc - 0x8000);
+        }
+
+        inline void record(unsigned short pc, unsigned int bank, unsigned int cycles) {
+            pc_stats& s = stats[slot(pc, bank)];
+            s.count++;
+            s.cycles += cycles;
+        }
+
+        void reset();
+
+        // Writes one "bank;block;instruction cycles" line per executed instruction, for
+        // flamegraph.pl, speedscope and similar tools.
+        bool write_collapsed(const char* path, const cpu* c) const;
+
+        // Writes the top_n basic blocks by total cycles, each with a listing of its
+        // instructions and their counts.
+        bool write_report(const char* path, const cpu* c, unsigned int top_n) const;
+
+    private:
+        struct block {
+            unsigned int first;
+            unsigned int last;
+            unsigned long long cycles;
+        };
+
+        void slot_address(unsigned int s, unsigned int& bank, unsigned short& pc) const;
+        unsigned char code_byte(const cpu* c, unsigned int s) const;
+        std::vector<block> find_blocks(const cpu* c) const;
+};
+
+#endif
\ No newline at end of file
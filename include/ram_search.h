@@ -0,0 +1,56 @@
+#ifndef RAM_SEARCH_H
+#define RAM_SEARCH_H
+
+#include <vector>
+
+class cpu;
+
+// Cheat-finder style search over work RAM (0xC000-0xDFFF, whichever CGB bank is mapped) and
+// HRAM (0xFF80-0xFFFF). Candidates are a bitset with one bit per byte offset, and each filter
+// step compares the whole current memory against the previous snapshot 16 bytes at a time,
+// ANDing the resulting masks into the bitset, so a step is well under a microsecond.
+class ram_search {
+    public:
+        enum compare { equal, changed, unchanged, increased, decreased };
+
+        // Searched bytes: work RAM followed by HRAM.
+        static const unsigned int size = 0x2000 + 0x80;
+
+        cpu* c;
+
+        ram_search(cpu* c);
+
+        // Makes every address a candidate again and snapshots the current memory.
+        void reset();
+
+        // Keeps the candidates whose 8- or 16-bit (little-endian) value passes op, then takes a
+        // new snapshot. equal compares against value; the others against the last snapshot.
+        // A 16-bit candidate at an address covers it and the next byte.
+        void filter(compare op, unsigned int width, unsigned int value = 0);
+
+        unsigned int count() const;
+
+        // Candidate addresses in ascending order, at most max of them.
+        std::vector<unsigned short> results(unsigned int max) const;
+
+        // Value at a searched address in the current snapshot.
+        unsigned int value_at(unsigned short addr, unsigned int width) const;
+
+        static unsigned short address(unsigned int offset) {
+            return static_cast<unsigned short>(offset < 0x2000 ? 0xC000 + offset : 0xFF80 + offset - 0x2000);
+        }
+
+    private:
+        static const unsigned int words = size / 64;
+
+        // Two snapshots, padded so a 16-byte load at offset + 1 stays in bounds; each filter
+        // step swaps them rather than copying.
+        unsigned char snapshots[2][size + 16];
+        unsigned char* previous;
+        unsigned char* current;
+        unsigned long long candidates[words];
+
+        void capture(unsigned char* out) const;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,95 @@
+#ifndef ROM_INDEX_H
+#define ROM_INDEX_H
+
+#include <string>
+#include <vector>
+
+// Cartridge header, 0x0100-0x014F. The title is NUL-terminated; CGB games may use its last
+// bytes for the manufacturer code and the CGB flag.
+struct rom_header {
+    char title[17];
+    unsigned char cgb_flag;
+    unsigned char sgb_flag;
+    unsigned char cartridge_type;
+    unsigned char rom_size;
+    unsigned char ram_size;
+    unsigned char version;
+    unsigned char header_checksum;
+    unsigned short global_checksum;
+
+    // Whether header_checksum matches bytes 0x0134-0x014C, as the boot ROM checks it.
+    bool header_valid;
+};
+
+// Fills out from a ROM image; false if it is too short to have a header.
+bool parse_rom_header(const unsigned char* data, unsigned long long size, rom_header& out);
+
+// Mapper named by the cartridge type byte (0x147), e.g. "MBC1" or "MBC5+RAM+BATTERY".
+const char* rom_mapper_name(unsigned char cartridge_type);
+
+// ROM and external RAM sizes in bytes from header bytes 0x148 and 0x149.
+unsigned long long rom_size_bytes(unsigned char rom_size);
+unsigned long long ram_size_bytes(unsigned char ram_size);
+
+// 64-bit content hash. Four independent lanes over 32-byte blocks, so it runs at memory speed.
+unsigned long long rom_hash(const unsigned char* data, unsigned long long size);
+
+struct rom_entry {
+    std::string path;
+    unsigned long long mtime;
+    unsigned long long size;
+    unsigned long long hash;
+    rom_header header;
+};
+
+// Metadata for every ROM under a directory, kept in a compact binary file. A rescan opens and
+// hashes only files whose size or modification time changed since the index was written;
+// everything else is taken from the index without touching the file.
+class rom_index {
+    public:
+        std::vector<rom_entry> entries;
+
+        // Files taken from the index and files opened by the last scan().
+        unsigned int reused = 0;
+        unsigned int opened = 0;
+
+        // A missing index file is not an error; it just leaves the index empty.
+        bool load(const char* path);
+        bool save(const char* path) const;
+
+        // Brings the index up to date with the .gb/.gbc files under dir (recursively); entries
+        // for files that are gone are dropped.
+        bool scan(const char* dir);
+
+        const rom_entry* find(unsigned long long hash) const;
+};
+
+// File layout: an index_file_header, then count records, each an index_record followed by
+// path_length bytes of UTF-8 path.
+struct index_file_header {
+    char magic[8];
+    unsigned int record_size;
+    unsigned int count;
+};
+
+struct index_record {
+    unsigned long long mtime;
+    unsigned long long size;
+    unsigned long long hash;
+    char title[16];
+    unsigned short global_checksum;
+    unsigned short path_length;
+    unsigned char cgb_flag;
+    unsigned char sgb_flag;
+    unsigned char cartridge_type;
+    unsigned char rom_size;
+    unsigned char ram_size;
+    unsigned char version;
+    unsigned char header_checksum;
+    unsigned char header_valid;
+};
+
+static_assert(sizeof(index_file_header) == 16, "index_file_header layout is part of the file format");
+static_assert(sizeof(index_record) == 56, "index_record layout is part of the file format");
+
+#endif
\ No newline at end of file
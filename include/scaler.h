@@ -0,0 +1,51 @@
+#ifndef SCALER_H
+#define SCALER_H
+
+#include <vector>
+
+// CPU-side upscaling of the ARGB8888 frame for hosts without GPU acceleration, where letting
+// SDL_RenderCopy stretch by size_modifier is a slow software blit. The frame is scaled once,
+// straight into the texture, and SDL copies it to the window (close to) 1:1.
+class scaler {
+    public:
+        enum filter { none, nearest, scale2x, scale3x, xbr };
+
+        filter mode;
+
+        // Output size over input size. scale2x and xbr scale by 2 and scale3x by 3
+        // (filter_factor); their output is then widened by nearest neighbour to size_modifier
+        // rounded down to a multiple of that, and at least filter_factor, so the window can
+        // always be a whole multiple of the frame. nearest uses size_modifier and none 1.
+        unsigned int factor;
+        unsigned int filter_factor;
+
+        scaler(filter mode, unsigned int size_modifier);
+
+        // Maps "none", "nearest", "scale2x", "scale3x" or "xbr" to a filter.
+        static bool parse(const char* name, filter& out);
+
+        // Scales width x height pixels from src (src_pitch pixels per row) into dst, which holds
+        // width * factor x height * factor pixels at dst_pitch pixels per row.
+        void run(const unsigned int* src, unsigned int src_pitch, unsigned int width, unsigned int height,
+            unsigned int* dst, unsigned int dst_pitch);
+
+    private:
+        // The source with a 2-pixel replicated border, so neighbour lookups need no edge
+        // checks, and its luma for xbr.
+        std::vector<unsigned int> padded;
+        std::vector<unsigned short> luma;
+        unsigned int padded_pitch = 0;
+
+        // The filter's output, when factor is larger than filter_factor.
+        std::vector<unsigned int> filtered;
+
+        void pad(const unsigned int* src, unsigned int src_pitch, unsigned int width, unsigned int height);
+
+        void run_nearest(const unsigned int* src, unsigned int src_pitch, unsigned int width, unsigned int height,
+            unsigned int* dst, unsigned int dst_pitch, unsigned int by);
+        void run_scale2x(unsigned int width, unsigned int height, unsigned int* dst, unsigned int dst_pitch);
+        void run_scale3x(unsigned int width, unsigned int height, unsigned int* dst, unsigned int dst_pitch);
+        void run_xbr(unsigned int width, unsigned int height, unsigned int* dst, unsigned int dst_pitch);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,126 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include <net.h>
+
+class cpu;
+
+// Carries link-cable messages between two instances. Each transferred byte costs one message
+// each way, so linked instances only synchronise at transfer boundaries.
+class link_transport {
+    public:
+        struct message {
+            unsigned char type;
+            unsigned char data;
+        };
+
+        virtual ~link_transport() {}
+
+        virtual bool send(message m) = 0;
+
+        // With wait false, returns false straight away when nothing has arrived. Also false
+        // once the peer is gone, after which connected is false.
+        virtual bool receive(message& m, bool wait) = 0;
+
+        bool connected = true;
+};
+
+// Both ends in one process, e.g. two instances on two threads.
+class local_link : public link_transport {
+    public:
+        // Creates two connected ends.
+        static void make_pair(std::unique_ptr<local_link>& a, std::unique_ptr<local_link>& b);
+
+        ~local_link();
+
+        bool send(message m) override;
+        bool receive(message& m, bool wait) override;
+
+        // Sleeps until a message is waiting or ms milliseconds have passed.
+        void wait_for_message(unsigned int ms);
+
+    private:
+        struct queue {
+            std::mutex lock;
+            std::condition_variable ready;
+            std::deque<message> items;
+            bool closed = false;
+        };
+
+        std::shared_ptr<queue> in;
+        std::shared_ptr<queue> out;
+};
+
+// Ends in two processes, over a Unix-domain socket.
+class socket_link : public link_transport {
+    public:
+        ~socket_link();
+
+        // Waits for the peer to connect on address.
+        bool listen(const char* address);
+        bool connect(const char* address);
+
+        bool send(message m) override;
+        bool receive(message& m, bool wait) override;
+
+    private:
+        net_socket s = net_invalid;
+};
+
+// The serial port: SB (0xFF01) and SC (0xFF02). A transfer on the internal clock sends SB to
+// the peer and waits for the peer's SB in return, then completes (SB replaced, SC bit 7
+// cleared, serial interrupt raised) 8 bit-times later. A transfer armed on the external clock
+// completes when a peer's transfer arrives. Without a peer the port reads 0xFF, as with no
+// cable plugged in.
+class serial {
+    public:
+        cpu* c;
+        link_transport* link = nullptr;
+
+        unsigned long long transfers = 0;
+
+        serial(cpu* c);
+
+        // Handles a CPU write to 0xFF01 or 0xFF02.
+        void write(unsigned short addr, unsigned char value);
+
+        // Answers any transfers the peer has started. step() does this on its own; this is for
+        // an instance that is idle, e.g. waiting for its lock-step partner. An idle instance's
+        // clock isn't moving, so it answers straight away instead of holding the transfer.
+        void poll();
+
+        // Called after each instruction; only does work at the next transfer or poll point.
+        inline void step() {
+            if (*cycles >= next_event) update();
+        }
+
+    private:
+        // Message types.
+        static const unsigned char start = 'S';
+        static const unsigned char reply = 'R';
+
+        const unsigned long long* cycles;
+
+        bool active = false;
+        unsigned long long done_at = 0;
+        unsigned char incoming = 0xFF;
+        unsigned long long next_event = 0;
+
+        // A peer transfer waiting for this side's clock to reach answer_at.
+        bool pending = false;
+        unsigned char pending_data = 0;
+        unsigned long long answer_at = 0;
+
+        void update();
+        void schedule();
+        void answer_peer(bool hold);
+        unsigned char answer(unsigned char data);
+        void complete(unsigned char data);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,65 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// One executed instruction, captured before it runs. Records are fixed-size so the ring can be
+// written with plain stores and decoded offline by tools/trace_decode.cpp.
+struct trace_record {
+    unsigned long long cycle;
+    unsigned short pc;
+    unsigned short sp;
+    unsigned char opcode;
+    unsigned char operand[2];
+    unsigned char bank;
+    unsigned char a, f, b, c, d, e, h, l;
+};
+
+// Layout of the start of a trace file; records follow immediately. head counts every record
+// ever written, so the newest record is at (head - 1) % capacity and the ring has wrapped once
+// head exceeds capacity.
+struct trace_header {
+    char magic[8];
+    unsigned int record_size;
+    unsigned int capacity;
+    unsigned long long head;
+};
+
+static_assert(sizeof(trace_record) == 24, "trace_record layout is part of the file format");
+static_assert(sizeof(trace_header) == 24, "trace_header layout is part of the file format");
+
+// Execution trace ring buffer backed by a memory-mapped file. Writing a record is a copy into
+// mapped memory; the OS pages it out, so a crash still leaves the most recent history on disk.
+class trace_buffer {
+    public:
+        trace_header* header = nullptr;
+        trace_record* records = nullptr;
+
+        trace_buffer();
+        ~trace_buffer();
+
+        // capacity is rounded up to a power of two, so finding a record's slot is a mask.
+        bool open(const char* path, unsigned int capacity);
+        void close();
+
+        // head is kept here and only stored to the mapped header, never read back from it.
+        inline trace_record& next() {
+            trace_record& r = records[head & mask];
+            header->head = ++head;
+            return r;
+        }
+
+    private:
+        unsigned long long head = 0;
+        unsigned long long mask = 0;
+
+        void* mapping = nullptr;
+        unsigned long long mapped_size = 0;
+
+#ifdef _WIN32
+        void* file_handle = nullptr;
+        void* map_handle = nullptr;
+#else
+        int fd = -1;
+#endif
+};
+
+#endif
\ No newline at end of file
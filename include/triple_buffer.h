@@ -0,0 +1,51 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstring>
+
+// Three 160x144 ARGB8888 framebuffers shared by the emulation thread (producer) and the
+// present thread (consumer). Each side owns one buffer; the third is parked in an atomic
+// index that both exchange with, so neither side ever blocks or sees a half-drawn frame.
+class triple_buffer {
+    public:
+        static const unsigned int pixels = 160 * 144;
+
+        triple_buffer() {
+            memset(buffers, 0xFF, sizeof(buffers));
+        }
+
+        // Producer: the buffer to draw the next frame into.
+        unsigned int* back() {
+            return buffers[back_index];
+        }
+
+        // Producer: hands back() over as the newest frame and takes the parked buffer in its
+        // place. A frame the consumer never picked up is simply overwritten.
+        void publish() {
+            back_index = shared.exchange(back_index | fresh, std::memory_order_acq_rel) & index_mask;
+        }
+
+        // Consumer: whether a frame was published since the last acquire().
+        bool has_new() const {
+            return (shared.load(std::memory_order_acquire) & fresh) != 0;
+        }
+
+        // Consumer: switches to the newest published frame, if there is one, and returns it.
+        const unsigned int* acquire() {
+            if (has_new()) front_index = shared.exchange(front_index, std::memory_order_acq_rel) & index_mask;
+            return buffers[front_index];
+        }
+
+    private:
+        static const unsigned int fresh = 4;
+        static const unsigned int index_mask = 3;
+
+        alignas(64) unsigned int buffers[3][pixels];
+
+        unsigned int back_index = 0;
+        unsigned int front_index = 2;
+        alignas(64) std::atomic<unsigned int> shared{1};
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,364 @@
+#include <cstring>
+
+#include <apu.h>
+#include <audio_ring.h>
+#include <cpu.h>
+
+// Waveforms for the four NRx1 duty settings, one bit per step (12.5%, 25%, 50%, 75%).
+static const unsigned char duty_patterns[4] = { 0x01, 0x81, 0x87, 0x7E };
+
+// Noise divisors for NR43 codes 0-7.
+static const unsigned int noise_divisors[8] = { 8, 16, 32, 48, 64, 80, 96, 112 };
+
+// The frame sequencer runs at 512 Hz.
+static const unsigned int sequencer_clocks = 8192;
+
+// Samples are handed to the ring about every 2 ms of emulated time.
+static const unsigned int flush_clocks = 8192;
+
+apu::apu(cpu* c, unsigned int sample_rate)
+    : left(clock_rate, sample_rate, sample_rate / 20), right(clock_rate, sample_rate, sample_rate / 20) {
+    this->c = c;
+    this->sample_rate = sample_rate;
+
+    time = c->cycles;
+    frame_start = time;
+    next_sequencer = time + sequencer_clocks;
+
+    load_registers();
+}
+
+// Replays NR10-NR51 through write() with the trigger bits cleared, then enables the channels
+// NR52 reports as running. A channel picked up this way starts silent, as channel 1 is once
+// the boot sound's envelope has run down.
+void apu::load_registers() {
+    unsigned char* mem = c->mram;
+    unsigned char status = mem[0xFF26];
+
+    for (channel& chan : ch) chan = channel();
+    power = false;
+    write(0xFF26, status);
+    if (!power) return;
+
+    unsigned char saved[0x16];
+    memcpy(saved, &mem[0xFF10], sizeof(saved));
+    for (unsigned short r = 0xFF10; r < 0xFF26; r++) {
+        bool control = r == 0xFF14 || r == 0xFF19 || r == 0xFF1E || r == 0xFF23;
+        write(r, control ? saved[r - 0xFF10] & 0x7F : saved[r - 0xFF10]);
+    }
+    memcpy(&mem[0xFF10], saved, sizeof(saved));
+
+    for (unsigned int i = 0; i < 4; i++) {
+        channel& chan = ch[i];
+        if (!(status & (1 << i)) || !chan.dac) continue;
+        chan.enabled = true;
+        chan.next_tick = time + chan.period;
+    }
+    update_status();
+}
+
+void apu::update_period(unsigned int i) {
+    channel& chan = ch[i];
+
+    if (i == 2) chan.period = (2048 - chan.freq) * 2;
+    else if (i == 3) chan.period = noise_divisors[c->mram[0xFF22] & 7] << (c->mram[0xFF22] >> 4);
+    else chan.period = (2048 - chan.freq) * 4;
+}
+
+unsigned int apu::sweep_target() {
+    channel& chan = ch[0];
+    unsigned int delta = chan.shadow_freq >> chan.sweep_shift;
+
+    if (!chan.sweep_negate) return chan.shadow_freq + delta;
+    return chan.shadow_freq - delta;
+}
+
+void apu::trigger(unsigned int i) {
+    channel& chan = ch[i];
+    unsigned char* mem = c->mram;
+
+    chan.enabled = chan.dac;
+    if (chan.length == 0) chan.length = i == 2 ? 256 : 64;
+
+    if (i != 2) {
+        unsigned char env = mem[0xFF12 + i * 5];
+        chan.volume = env >> 4;
+        chan.env_add = (env & 0x08) != 0;
+        chan.env_period = env & 7;
+        chan.env_timer = chan.env_period;
+    }
+
+    if (i == 2) chan.phase = 0;
+    if (i == 3) chan.lfsr = 0x7FFF;
+
+    update_period(i);
+    chan.next_tick = time + chan.period;
+
+    if (i == 0) {
+        chan.shadow_freq = chan.freq;
+        chan.sweep_timer = chan.sweep_period ? chan.sweep_period : 8;
+        chan.sweep_enabled = chan.sweep_period != 0 || chan.sweep_shift != 0;
+        if (chan.sweep_shift != 0 && sweep_target() > 2047) chan.enabled = false;
+    }
+}
+
+void apu::write(unsigned short addr, unsigned char value) {
+    run_until(c->cycles);
+
+    unsigned char* mem = c->mram;
+
+    // Only NR52 and wave RAM are writable while the APU is powered off.
+    if (!power && addr < 0xFF26) return;
+
+    mem[addr] = value;
+
+    switch (addr) {
+        case 0xFF10:
+            ch[0].sweep_period = (value >> 4) & 7;
+            ch[0].sweep_negate = (value & 0x08) != 0;
+            ch[0].sweep_shift = value & 7;
+            break;
+
+        case 0xFF11: case 0xFF16: {
+            channel& chan = ch[addr == 0xFF11 ? 0 : 1];
+            chan.duty = value >> 6;
+            chan.length = 64 - (value & 0x3F);
+            break;
+        }
+
+        case 0xFF12: case 0xFF17: case 0xFF21: {
+            channel& chan = ch[(addr - 0xFF12) / 5];
+            chan.dac = (value & 0xF8) != 0;
+            if (!chan.dac) chan.enabled = false;
+            break;
+        }
+
+        case 0xFF13: case 0xFF18: case 0xFF1D: {
+            unsigned int i = (addr - 0xFF13) / 5;
+            ch[i].freq = (ch[i].freq & 0x700) | value;
+            update_period(i);
+            break;
+        }
+
+        case 0xFF14: case 0xFF19: case 0xFF1E: case 0xFF23: {
+            unsigned int i = (addr - 0xFF14) / 5;
+            if (i != 3) {
+                ch[i].freq = (ch[i].freq & 0xFF) | ((value & 7) << 8);
+                update_period(i);
+            }
+            ch[i].length_enable = (value & 0x40) != 0;
+            if (value & 0x80) trigger(i);
+            break;
+        }
+
+        case 0xFF1A:
+            ch[2].dac = (value & 0x80) != 0;
+            if (!ch[2].dac) ch[2].enabled = false;
+            break;
+
+        case 0xFF1B:
+            ch[2].length = 256 - value;
+            break;
+
+        case 0xFF1C:
+            ch[2].volume_code = (value >> 5) & 3;
+            break;
+
+        case 0xFF20:
+            ch[3].length = 64 - (value & 0x3F);
+            break;
+
+        case 0xFF22:
+            ch[3].narrow = (value & 0x08) != 0;
+            update_period(3);
+            break;
+
+        case 0xFF26:
+            if (!(value & 0x80) && power) {
+                for (unsigned short r = 0xFF10; r < 0xFF26; r++) mem[r] = 0;
+                for (channel& chan : ch) {
+                    unsigned int length = chan.length;
+                    chan = channel();
+                    chan.length = length;
+                }
+            }
+            if ((value & 0x80) && !power) sequencer_step = 0;
+            power = (value & 0x80) != 0;
+            break;
+    }
+
+    for (unsigned int i = 0; i < 4; i++) update_output(i, time);
+    update_status();
+}
+
+// NR52 reports power and which channels are running; the other bits read as 1.
+void apu::update_status() {
+    unsigned char status = (power ? 0x80 : 0x00) | 0x70;
+    for (unsigned int i = 0; i < 4; i++) {
+        if (ch[i].enabled) status |= 1 << i;
+    }
+    c->mram[0xFF26] = status;
+}
+
+unsigned int apu::channel_level(unsigned int i) const {
+    const channel& chan = ch[i];
+    if (!chan.enabled || !chan.dac) return 0;
+
+    switch (i) {
+        case 0: case 1:
+            return (duty_patterns[chan.duty] >> chan.phase) & 1 ? chan.volume : 0;
+        case 2: {
+            if (chan.volume_code == 0) return 0;
+            unsigned char pair = c->mram[0xFF30 + chan.phase / 2];
+            unsigned int sample = (chan.phase & 1) ? pair & 0x0F : pair >> 4;
+            return sample >> (chan.volume_code - 1);
+        }
+        default:
+            return (~chan.lfsr & 1) ? chan.volume : 0;
+    }
+}
+
+// Turns the channel's level into left and right amplitudes through NR51 panning and NR50
+// master volume, and records any change as a delta at clock t.
+void apu::update_output(unsigned int i, unsigned long long t) {
+    channel& chan = ch[i];
+    const unsigned char* mem = c->mram;
+
+    int level = static_cast<int>(channel_level(i));
+    unsigned char nr50 = mem[0xFF24];
+    unsigned char nr51 = mem[0xFF25];
+
+    int l = (nr51 >> (4 + i)) & 1 ? level * (((nr50 >> 4) & 7) + 1) * 32 : 0;
+    int r = (nr51 >> i) & 1 ? level * ((nr50 & 7) + 1) * 32 : 0;
+
+    unsigned int when = static_cast<unsigned int>(t - frame_start);
+    if (l != chan.out_left) {
+        left.add_delta(when, l - chan.out_left);
+        chan.out_left = l;
+    }
+    if (r != chan.out_right) {
+        right.add_delta(when, r - chan.out_right);
+        chan.out_right = r;
+    }
+}
+
+void apu::run_channels(unsigned long long end) {
+    for (unsigned int i = 0; i < 4; i++) {
+        channel& chan = ch[i];
+        if (!chan.enabled) continue;
+
+        while (chan.next_tick <= end) {
+            if (i == 3) {
+                unsigned int bit = (chan.lfsr ^ (chan.lfsr >> 1)) & 1;
+                chan.lfsr = (chan.lfsr >> 1) | (bit << 14);
+                if (chan.narrow) chan.lfsr = (chan.lfsr & ~0x40u) | (bit << 6);
+            } else if (i == 2) {
+                chan.phase = (chan.phase + 1) & 31;
+            } else {
+                chan.phase = (chan.phase + 1) & 7;
+            }
+
+            update_output(i, chan.next_tick);
+            chan.next_tick += chan.period;
+        }
+    }
+}
+
+// Steps 0, 2, 4 and 6 clock the length counters, 2 and 6 the sweep, and 7 the envelopes.
+void apu::clock_sequencer() {
+    unsigned int step = sequencer_step;
+    sequencer_step = (sequencer_step + 1) & 7;
+    if (!power) return;
+
+    if ((step & 1) == 0) {
+        for (channel& chan : ch) {
+            if (chan.length_enable && chan.length > 0 && --chan.length == 0) chan.enabled = false;
+        }
+    }
+
+    if (step == 2 || step == 6) {
+        channel& chan = ch[0];
+        if (chan.sweep_timer > 0 && --chan.sweep_timer == 0) {
+            chan.sweep_timer = chan.sweep_period ? chan.sweep_period : 8;
+
+            if (chan.sweep_enabled && chan.sweep_period != 0) {
+                unsigned int target = sweep_target();
+                if (target > 2047) {
+                    chan.enabled = false;
+                } else if (chan.sweep_shift != 0) {
+                    chan.freq = target;
+                    chan.shadow_freq = target;
+                    c->mram[0xFF13] = target & 0xFF;
+                    c->mram[0xFF14] = (c->mram[0xFF14] & 0xF8) | (target >> 8);
+                    update_period(0);
+                    if (sweep_target() > 2047) chan.enabled = false;
+                }
+            }
+        }
+    }
+
+    if (step == 7) {
+        for (unsigned int i = 0; i < 4; i++) {
+            channel& chan = ch[i];
+            if (i == 2 || chan.env_period == 0) continue;
+            if (--chan.env_timer > 0) continue;
+
+            chan.env_timer = chan.env_period;
+            if (chan.env_add && chan.volume < 15) chan.volume++;
+            else if (!chan.env_add && chan.volume > 0) chan.volume--;
+        }
+    }
+
+    for (unsigned int i = 0; i < 4; i++) update_output(i, time);
+    update_status();
+}
+
+void apu::run_until(unsigned long long target) {
+    while (time < target) {
+        unsigned long long end = target;
+        if (end > next_sequencer) end = next_sequencer;
+        if (end > frame_start + flush_clocks) end = frame_start + flush_clocks;
+
+        run_channels(end);
+        time = end;
+
+        if (time == next_sequencer) {
+            clock_sequencer();
+            next_sequencer += sequencer_clocks;
+        }
+        if (time - frame_start >= flush_clocks) flush();
+    }
+}
+
+void apu::set_rate_adjust(double ratio) {
+    // Close the current blip frame first so deltas already placed keep their sample positions.
+    flush();
+    left.set_rates(clock_rate, sample_rate * ratio);
+    right.set_rates(clock_rate, sample_rate * ratio);
+}
+
+// Closes the current blip frame and moves the finished stereo samples into the ring.
+void apu::flush() {
+    unsigned int clocks = static_cast<unsigned int>(time - frame_start);
+    left.end_frame(clocks);
+    right.end_frame(clocks);
+    frame_start = time;
+
+    unsigned int count = left.samples_avail();
+    if (count == 0) return;
+
+    scratch.resize(count * 2);
+    left.read_samples(&scratch[0], count, 2);
+    right.read_samples(&scratch[1], count, 2);
+
+    if (out == nullptr) return;
+
+    // Keep left/right pairs together when the ring is nearly full.
+    unsigned int space = (out->capacity() - out->size()) & ~1u;
+    unsigned int n = count * 2;
+    if (n > space) {
+        samples_dropped += (n - space) / 2;
+        n = space;
+    }
+    out->write(scratch.data(), n);
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include <cstring>
+#include <iostream>
+
+#include <audio.h>
+#include <audio_ring.h>
+
+using std::cout;
+using std::endl;
+
+audio::audio(audio_ring* ring, unsigned int sample_rate, unsigned int buffer_frames) {
+    this->ring = ring;
+    this->sample_rate = sample_rate;
+    this->buffer_frames = buffer_frames;
+    target_frames = buffer_frames * 2;
+    memset(&spec, 0, sizeof(spec));
+}
+
+audio::~audio() {
+    close();
+}
+
+bool audio::open() {
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0) {
+        cout << "Error: problem initialising SDL audio: " << SDL_GetError() << endl;
+        return false;
+    }
+
+    SDL_AudioSpec want;
+    memset(&want, 0, sizeof(want));
+    want.freq = sample_rate;
+    want.format = AUDIO_S16SYS;
+    want.channels = 2;
+    want.samples = buffer_frames;
+    want.callback = callback;
+    want.userdata = this;
+
+    device = SDL_OpenAudioDevice(nullptr, 0, &want, &spec, 0);
+    if (device == 0) {
+        cout << "Error: problem opening audio device: " << SDL_GetError() << endl;
+        return false;
+    }
+
+    SDL_PauseAudioDevice(device, 0);
+    return true;
+}
+
+void audio::close() {
+    if (device == 0) return;
+    SDL_CloseAudioDevice(device);
+    device = 0;
+}
+
+double audio::pace() {
+    if (device == 0) return 1.0;
+
+    // Measured before the wait below, which would otherwise always leave the depth at or under
+    // the target and the ratio at or over 1. Averaged over a few frames so scheduler jitter
+    // doesn't turn into pitch wobble.
+    double depth = ring->size() / 2;
+    depth_average += (depth - depth_average) * 0.1;
+
+    while (ring->size() / 2 > target_frames) SDL_Delay(1);
+
+    double error = (target_frames - depth_average) / target_frames;
+    if (error > 1) error = 1;
+    if (error < -1) error = -1;
+
+    return 1.0 + error * 0.005;
+}
+
+void audio::callback(void* userdata, Uint8* stream, int len) {
+    audio* a = static_cast<audio*>(userdata);
+    short* out = reinterpret_cast<short*>(stream);
+    unsigned int wanted = static_cast<unsigned int>(len) / sizeof(short);
+
+    unsigned int got = a->ring->read(out, wanted);
+    if (got >= 2) {
+        a->last[0] = out[got - 2];
+        a->last[1] = out[got - 1];
+    }
+
+    if (got < wanted) {
+        a->underruns.fetch_add(1, std::memory_order_relaxed);
+        for (unsigned int i = got; i < wanted; i++) out[i] = a->last[i & 1];
+    }
+}
@@ -0,0 +1,76 @@
+#include <cmath>
+#include <cstring>
+
+#include <blip.h>
+
+blip_buffer::blip_buffer(double clock_rate, double sample_rate, unsigned int max_samples) {
+    buf.resize(max_samples + width + 1);
+    set_rates(clock_rate, sample_rate);
+    build_kernel();
+}
+
+void blip_buffer::set_rates(double clock_rate, double sample_rate) {
+    factor = static_cast<unsigned long long>(sample_rate / clock_rate * 4294967296.0 + 0.5);
+}
+
+// Blackman-windowed sinc, cut off a little below the output Nyquist frequency, sampled at each
+// sub-sample phase. Every phase is normalised to sum to 1 so a delta adds exactly its size
+// to the integrated output.
+void blip_buffer::build_kernel() {
+    const double pi = 3.14159265358979323846;
+    const double cutoff = 0.9;
+
+    for (int p = 0; p < phases; p++) {
+        double frac = static_cast<double>(p) / phases;
+        double taps[width];
+        double sum = 0;
+
+        for (int i = 0; i < width; i++) {
+            double x = i - (width / 2 - 1) - frac;
+            double sinc = x == 0 ? 1.0 : sin(pi * cutoff * x) / (pi * cutoff * x);
+            double u = (x + width / 2) / width;
+            double window = 0.42 - 0.5 * cos(2 * pi * u) + 0.08 * cos(4 * pi * u);
+
+            taps[i] = cutoff * sinc * window;
+            sum += taps[i];
+        }
+
+        for (int i = 0; i < width; i++) kernel[p][i] = static_cast<float>(taps[i] / sum);
+    }
+}
+
+void blip_buffer::end_frame(unsigned int clocks) {
+    offset += clocks * factor;
+}
+
+unsigned int blip_buffer::max_frame_clocks() const {
+    unsigned long long room = buf.size() - width - 1 - samples_avail();
+    return static_cast<unsigned int>((room << 32) / factor);
+}
+
+unsigned int blip_buffer::samples_avail() const {
+    return static_cast<unsigned int>(offset >> 32);
+}
+
+unsigned int blip_buffer::read_samples(short* out, unsigned int count, unsigned int stride) {
+    unsigned int avail = samples_avail();
+    if (count > avail) count = avail;
+
+    for (unsigned int i = 0; i < count; i++) {
+        integrator += buf[i];
+
+        // One-pole high-pass to remove the DC offset of the unipolar channel outputs.
+        float sample = integrator - highpass;
+        highpass += sample * (1.0f / 256);
+
+        if (sample > 32767) sample = 32767;
+        if (sample < -32768) sample = -32768;
+        out[i * stride] = static_cast<short>(sample);
+    }
+
+    memmove(buf.data(), buf.data() + count, (buf.size() - count) * sizeof(float));
+    memset(buf.data() + buf.size() - count, 0, count * sizeof(float));
+    offset -= static_cast<unsigned long long>(count) << 32;
+
+    return count;
+}
\ No newline at end of file
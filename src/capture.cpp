@@ -0,0 +1,273 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include <capture.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <signal.h>
+#endif
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+static const char* pipe_mode = "wb";
+#else
+static const char* pipe_mode = "w";
+#endif
+
+using std::cout;
+using std::endl;
+using std::string;
+
+frame_capture::frame_capture() {}
+
+frame_capture::~frame_capture() {
+    stop();
+}
+
+static bool ends_with(const string& s, const char* suffix) {
+    size_t n = strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+bool frame_capture::start(const char* target, unsigned int buffers) {
+    stop();
+
+    path = target;
+    if (!path.empty() && path[0] == '|') kind = pipe;
+    else if (ends_with(path, ".y4m")) kind = y4m;
+    else if (ends_with(path, ".png")) kind = png;
+    else kind = raw;
+
+    if (kind == pipe) {
+        out = popen(path.c_str() + 1, pipe_mode);
+        if (out == nullptr) {
+            cout << "Error: problem starting capture command " << path.c_str() + 1 << endl;
+            return false;
+        }
+    } else if (kind != png) {
+        out = fopen(path.c_str(), "wb");
+        if (out == nullptr) {
+            cout << "Error: problem creating capture at " << path << endl;
+            return false;
+        }
+        setvbuf(out, nullptr, _IOFBF, 1 << 20);
+    }
+
+    // 4194304 / 70224 is the DMG frame rate, 59.73 Hz.
+    if (kind == y4m) fputs("YUV4MPEG2 W160 H144 F4194304:70224 Ip A1:1 C444\n", out);
+
+    slots = buffers < 2 ? 2 : buffers;
+    pool.assign(static_cast<size_t>(slots) * pixels, 0);
+    scratch.reserve(pixels * 3 + 0x1000);
+    head = 0;
+    tail = 0;
+    captured = 0;
+    dropped = 0;
+    stopping = false;
+    failed = false;
+
+    encoder = std::thread(&frame_capture::run, this);
+    return true;
+}
+
+void frame_capture::push(const unsigned int* frame, unsigned int pitch) {
+    if (slots == 0 || failed.load(std::memory_order_relaxed)) return;
+
+    unsigned long long h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= slots) {
+        dropped++;
+        return;
+    }
+
+    unsigned int* slot = &pool[(h % slots) * pixels];
+    if (pitch == 160) {
+        memcpy(slot, frame, pixels * sizeof(unsigned int));
+    } else {
+        for (unsigned int y = 0; y < 144; y++) memcpy(slot + y * 160, frame + y * pitch, 160 * sizeof(unsigned int));
+    }
+
+    head.store(h + 1, std::memory_order_release);
+    if (idle.load(std::memory_order_acquire)) wake.notify_one();
+}
+
+void frame_capture::stop() {
+    if (!encoder.joinable()) return;
+
+    stopping = true;
+    wake.notify_one();
+    encoder.join();
+
+    pool.clear();
+    pool.shrink_to_fit();
+    slots = 0;
+}
+
+// push() only notifies while the encoder is idle, and without taking the lock. The wait has a
+// timeout so a wakeup lost in that window costs a few milliseconds, never a frame.
+void frame_capture::run() {
+#ifndef _WIN32
+    // A capture command that exits closes its end of the pipe. Writing to it then fails with
+    // EPIPE on this thread rather than raising SIGPIPE, which would kill the emulator.
+    sigset_t pipe_signal;
+    sigemptyset(&pipe_signal);
+    sigaddset(&pipe_signal, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe_signal, nullptr);
+#endif
+
+    bool ok = true;
+    while (ok) {
+        unsigned long long t = tail.load(std::memory_order_relaxed);
+
+        if (t == head.load(std::memory_order_acquire)) {
+            if (stopping) break;
+
+            std::unique_lock<std::mutex> lock(wake_lock);
+            idle.store(true, std::memory_order_release);
+            if (t == head.load(std::memory_order_acquire)) wake.wait_for(lock, std::chrono::milliseconds(5));
+            idle.store(false, std::memory_order_relaxed);
+            continue;
+        }
+
+        ok = encode(&pool[(t % slots) * pixels], captured);
+        if (ok) captured++;
+        tail.store(t + 1, std::memory_order_release);
+    }
+    if (!ok) failed = true;
+
+    // Closed on this thread too, since closing flushes the last buffered frames.
+    if (out != nullptr) {
+        if (fflush(out) != 0) ok = false;
+        if (kind == pipe) pclose(out);
+        else if (fclose(out) != 0) ok = false;
+        out = nullptr;
+    }
+
+    if (!ok && kind != png) {
+        cout << "Error: problem writing capture to " << (kind == pipe ? path.c_str() + 1 : path.c_str())
+            << ", capture stopped" << endl;
+    }
+}
+
+bool frame_capture::encode(const unsigned int* frame, unsigned long long number) {
+    if (kind == png) return write_png(frame, number);
+
+    scratch.resize(pixels * 3);
+    unsigned char* p = scratch.data();
+
+    if (kind == y4m) {
+        // BT.601 limited range, the default Y4M readers assume.
+        unsigned char* y = p;
+        unsigned char* u = p + pixels;
+        unsigned char* v = p + pixels * 2;
+        for (unsigned int i = 0; i < pixels; i++) {
+            int r = (frame[i] >> 16) & 0xFF, g = (frame[i] >> 8) & 0xFF, b = frame[i] & 0xFF;
+            y[i] = static_cast<unsigned char>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+            u[i] = static_cast<unsigned char>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            v[i] = static_cast<unsigned char>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+        fputs("FRAME\n", out);
+    } else {
+        for (unsigned int i = 0; i < pixels; i++) {
+            p[i * 3] = static_cast<unsigned char>(frame[i] >> 16);
+            p[i * 3 + 1] = static_cast<unsigned char>(frame[i] >> 8);
+            p[i * 3 + 2] = static_cast<unsigned char>(frame[i]);
+        }
+    }
+
+    return fwrite(p, 1, scratch.size(), out) == scratch.size() && !ferror(out);
+}
+
+struct crc_table {
+    unsigned int entries[256];
+
+    crc_table() {
+        for (unsigned int n = 0; n < 256; n++) {
+            unsigned int c = n;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            entries[n] = c;
+        }
+    }
+};
+
+static unsigned int crc32(const unsigned char* data, size_t size) {
+    static const crc_table table;
+
+    unsigned int crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++) crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void put32(std::vector<unsigned char>& v, unsigned int x) {
+    v.push_back(static_cast<unsigned char>(x >> 24));
+    v.push_back(static_cast<unsigned char>(x >> 16));
+    v.push_back(static_cast<unsigned char>(x >> 8));
+    v.push_back(static_cast<unsigned char>(x));
+}
+
+static void put_chunk(std::vector<unsigned char>& v, const char* type, const unsigned char* data, unsigned int size) {
+    put32(v, size);
+    size_t start = v.size();
+    v.insert(v.end(), type, type + 4);
+    v.insert(v.end(), data, data + size);
+    put32(v, crc32(&v[start], size + 4));
+}
+
+// An RGB PNG whose zlib stream uses stored (uncompressed) deflate blocks: about 70 KB a frame,
+// no compression library, and cheap enough to keep up with the emulator. Recompress offline if
+// size matters.
+bool frame_capture::write_png(const unsigned int* frame, unsigned long long number) {
+    const unsigned int row = 1 + 160 * 3;
+    std::vector<unsigned char> image(row * 144);
+    for (unsigned int y = 0; y < 144; y++) {
+        unsigned char* r = &image[y * row];
+        r[0] = 0;
+        for (unsigned int x = 0; x < 160; x++) {
+            unsigned int c = frame[y * 160 + x];
+            r[1 + x * 3] = static_cast<unsigned char>(c >> 16);
+            r[2 + x * 3] = static_cast<unsigned char>(c >> 8);
+            r[3 + x * 3] = static_cast<unsigned char>(c);
+        }
+    }
+
+    std::vector<unsigned char> z = { 0x78, 0x01 };
+    unsigned int a = 1, b = 0;
+    for (unsigned char byte : image) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    for (size_t at = 0; at < image.size(); at += 0xFFFF) {
+        unsigned int n = static_cast<unsigned int>(image.size() - at < 0xFFFF ? image.size() - at : 0xFFFF);
+        z.push_back(at + n == image.size() ? 1 : 0);
+        z.push_back(static_cast<unsigned char>(n));
+        z.push_back(static_cast<unsigned char>(n >> 8));
+        z.push_back(static_cast<unsigned char>(~n));
+        z.push_back(static_cast<unsigned char>(~n >> 8));
+        z.insert(z.end(), image.begin() + at, image.begin() + at + n);
+    }
+    put32(z, b << 16 | a);
+
+    const unsigned char ihdr[13] = { 0, 0, 0, 160, 0, 0, 0, 144, 8, 2, 0, 0, 0 };
+    scratch.assign({ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' });
+    put_chunk(scratch, "IHDR", ihdr, sizeof(ihdr));
+    put_chunk(scratch, "IDAT", z.data(), static_cast<unsigned int>(z.size()));
+    put_chunk(scratch, "IEND", nullptr, 0);
+
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), "%06llu.png", number);
+    string name = path.substr(0, path.size() - 4) + suffix;
+
+    FILE* f = fopen(name.c_str(), "wb");
+    if (f == nullptr) {
+        cout << "Error: problem creating capture at " << name << ", capture stopped" << endl;
+        return false;
+    }
+    bool written = fwrite(scratch.data(), 1, scratch.size(), f) == scratch.size();
+    if (fclose(f) != 0 || !written) {
+        cout << "Error: problem writing capture at " << name << ", capture stopped" << endl;
+        return false;
+    }
+    return true;
+}
\ No newline at end of file
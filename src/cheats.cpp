@@ -0,0 +1,160 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include <cheats.h>
+#include <cpu.h>
+
+using std::cout;
+using std::endl;
+using std::string;
+
+static int hex_digit(char ch) {
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    return -1;
+}
+
+// Hex digits of text with dashes and spaces dropped, or an empty string if anything else
+// is in it.
+static string hex_only(const char* text) {
+    string out;
+    for (const char* p = text; *p; p++) {
+        if (*p == '-' || *p == ' ') continue;
+        if (hex_digit(*p) < 0) return "";
+        out += *p;
+    }
+    return out;
+}
+
+cheats::cheats(cpu* c) {
+    this->c = c;
+}
+
+bool cheats::add(const char* code) {
+    string text = code;
+    size_t eq = text.find('=');
+
+    if (eq != string::npos) {
+        string addr = hex_only(text.substr(0, eq).c_str());
+        string value = hex_only(text.substr(eq + 1).c_str());
+        if (addr.empty() || addr.size() > 4 || value.empty() || value.size() > 2) {
+            cout << "Error: problem parsing cheat " << code << endl;
+            return false;
+        }
+        writes.push_back({ static_cast<unsigned short>(stoul(addr, nullptr, 16)), static_cast<unsigned char>(stoul(value, nullptr, 16)), 0 });
+        return true;
+    }
+
+    if (text.find('-') != string::npos || hex_only(code).size() == 6 || hex_only(code).size() == 9) return add_game_genie(code);
+
+    // GameShark: type 01 writes whatever RAM is mapped; 8X / 9X pick CGB WRAM bank X for
+    // 0xD000-0xDFFF.
+    string digits = hex_only(code);
+    if (digits.size() != 8) {
+        cout << "Error: problem parsing cheat " << code << endl;
+        return false;
+    }
+
+    unsigned long raw = stoul(digits, nullptr, 16);
+    unsigned char type = static_cast<unsigned char>(raw >> 24);
+    unsigned char value = static_cast<unsigned char>(raw >> 16);
+    unsigned short addr = static_cast<unsigned short>(((raw & 0xFF) << 8) | ((raw >> 8) & 0xFF));
+
+    unsigned char bank = 0;
+    if ((type & 0xE0) == 0x80 && addr >= 0xD000 && addr < 0xE000) bank = type & 0x07 ? type & 0x07 : 1;
+
+    writes.push_back({ addr, value, bank });
+    return true;
+}
+
+// ABC-DEF-GHI: AB is the new value; the address is FCDE with F inverted; GI, when present, is
+// the expected old value XOR 0xBA rotated left by 2. H is unused.
+bool cheats::add_game_genie(const char* code) {
+    string digits = hex_only(code);
+    if (digits.size() != 6 && digits.size() != 9) {
+        cout << "Error: problem parsing cheat " << code << endl;
+        return false;
+    }
+
+    int d[9];
+    for (size_t i = 0; i < digits.size(); i++) d[i] = hex_digit(digits[i]);
+
+    rom_patch p;
+    p.value = static_cast<unsigned char>(d[0] << 4 | d[1]);
+    p.addr = static_cast<unsigned short>((d[5] ^ 0xF) << 12 | d[2] << 8 | d[3] << 4 | d[4]);
+    p.has_compare = digits.size() == 9;
+    p.compare = 0;
+    if (p.has_compare) {
+        unsigned int gi = d[6] << 4 | d[8];
+        p.compare = static_cast<unsigned char>(((gi >> 2) | (gi << 6)) ^ 0xBA);
+    }
+
+    if (p.addr >= 0x8000) {
+        cout << "Error: Game Genie code " << code << " is outside ROM" << endl;
+        return false;
+    }
+
+    patches.push_back(p);
+    patch_rom();
+    return true;
+}
+
+// Puts every patched page back to its original bytes, then writes each patch whose compare
+// value (if any) matches the original byte. Pages are saved the first time they are patched.
+// Pages under a mapped boot ROM are patched in the cartridge copy the unmap restores.
+void cheats::patch_rom() {
+    for (const rom_page& page : pages) memcpy(c->cart_byte(page.base), page.original, sizeof(page.original));
+
+    for (const rom_patch& p : patches) {
+        unsigned short base = p.addr & 0xFF00;
+
+        const rom_page* page = nullptr;
+        for (const rom_page& existing : pages) {
+            if (existing.base == base) page = &existing;
+        }
+        if (page == nullptr) {
+            pages.push_back(rom_page());
+            pages.back().base = base;
+            memcpy(pages.back().original, c->cart_byte(base), sizeof(pages.back().original));
+            page = &pages.back();
+        }
+
+        if (p.has_compare && page->original[p.addr & 0xFF] != p.compare) continue;
+        *c->cart_byte(p.addr) = p.value;
+    }
+}
+
+void cheats::clear() {
+    for (const rom_page& page : pages) memcpy(c->cart_byte(page.base), page.original, sizeof(page.original));
+    pages.clear();
+    patches.clear();
+    writes.clear();
+}
+
+bool cheats::load(const char* path) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        cout << "Error: problem loading cheats at " << path << endl;
+        return false;
+    }
+
+    bool ok = true;
+    string line;
+    while (std::getline(in, line)) {
+        line = line.substr(0, line.find('#'));
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == string::npos) continue;
+        size_t end = line.find_last_not_of(" \t\r");
+        ok = add(line.substr(start, end - start + 1).c_str()) && ok;
+    }
+    return ok;
+}
+
+// Banked writes go to the WRAM store unless that bank is the one mapped at 0xD000.
+unsigned char* cheats::target(const ram_write& w) {
+    if (w.bank != 0 && c->cgb && w.bank != c->wram_select) return &c->wram[w.bank * 0x1000 + (w.addr - 0xD000)];
+    return &c->mram[w.addr];
+}
@@ -1,8 +1,15 @@
 #include <bitset>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 
+#include <apu.h>
 #include <cpu.h>
+#include <debugger.h>
+#include <opcodes.h>
+#include <profiler.h>
+#include <serial.h>
+#include <trace.h>
 
 using std::cout;
 using std::endl;
@@ -19,6 +26,72 @@ cpu::cpu() {
     registers.f = 0x0;
     registers.h = 0x0;
     registers.l = 0x0;
+
+    memset(vram, 0, sizeof(vram));
+    memset(wram, 0, sizeof(wram));
+    memset(bg_palette, 0xFF, sizeof(bg_palette));
+    memset(obj_palette, 0xFF, sizeof(obj_palette));
+}
+
+void cpu::save_state(state& s) const {
+    s.regs = registers;
+    s.prog_counter = prog_counter;
+    s.prog_counter_copy = prog_counter_copy;
+    s.stack_pointer = stack_pointer;
+    memcpy(s.stack, stack, sizeof(stack));
+    s.cycles = cycles;
+    s.step_cycles = step_cycles;
+    s.rom_bank = rom_bank;
+    s.running = running;
+    memcpy(s.memory, mram, sizeof(s.memory));
+
+    memcpy(s.vram, vram, sizeof(vram));
+    memcpy(s.wram, wram, sizeof(wram));
+    memcpy(s.bg_palette, bg_palette, sizeof(bg_palette));
+    memcpy(s.obj_palette, obj_palette, sizeof(obj_palette));
+    s.double_speed = double_speed;
+    s.vram_select = vram_select;
+    s.wram_select = wram_select;
+    s.hdma_active = hdma_active;
+    s.hdma_src = hdma_src;
+    s.hdma_dst = hdma_dst;
+    s.hdma_blocks = hdma_blocks;
+    s.dma_stall = dma_stall;
+    s.oam_dma_start = oam_dma_start;
+    s.oam_dma_end = oam_dma_end;
+    s.oam_dma_source = oam_dma_source;
+    s.boot_rom_mapped = boot_rom_mapped;
+}
+
+void cpu::load_state(const state& s) {
+    registers = s.regs;
+    prog_counter = s.prog_counter;
+    prog_counter_copy = s.prog_counter_copy;
+    stack_pointer = s.stack_pointer;
+    memcpy(stack, s.stack, sizeof(stack));
+    cycles = s.cycles;
+    step_cycles = s.step_cycles;
+    rom_bank = s.rom_bank;
+    running = s.running;
+    memcpy(mram, s.memory, sizeof(s.memory));
+
+    memcpy(vram, s.vram, sizeof(vram));
+    memcpy(wram, s.wram, sizeof(wram));
+    memcpy(bg_palette, s.bg_palette, sizeof(bg_palette));
+    memcpy(obj_palette, s.obj_palette, sizeof(obj_palette));
+    double_speed = s.double_speed;
+    vram_select = s.vram_select;
+    wram_select = s.wram_select;
+    hdma_active = s.hdma_active;
+    hdma_src = s.hdma_src;
+    hdma_dst = s.hdma_dst;
+    hdma_blocks = s.hdma_blocks;
+    dma_stall = s.dma_stall;
+    oam_dma_start = s.oam_dma_start;
+    oam_dma_end = s.oam_dma_end;
+    oam_dma_source = s.oam_dma_source;
+    boot_rom_mapped = s.boot_rom_mapped;
+    update_access_checks();
 }
 
 bool cpu::load_rom(const char* rom) {
@@ -26,15 +99,23 @@ bool cpu::load_rom(const char* rom) {
 
 	if (in.is_open()) {
 		std::streampos size = in.tellg();
-		char* buffer = new char[size];
+        if (size > static_cast<std::streampos>(sizeof(mram))) {
+            cout << "Error: rom at " << rom << " is too large" << endl;
+            return false;
+        }
 
 		in.seekg(0, ios::beg);
-		in.read(buffer, size);
+		in.read(reinterpret_cast<char*>(mram), size);
 		in.close();
 
-		for (int i = 0; i < size; ++i) {
-			mram[i] = buffer[i];
-		}
+        rom_banks = static_cast<unsigned int>((static_cast<long long>(size) + 0x3FFF) / 0x4000);
+        if (rom_banks < 2) rom_banks = 2;
+
+        // Header byte 0x143 has bit 7 set for CGB-enhanced (0x80) and CGB-only (0xC0) games.
+        cgb = size > 0x143 && (mram[0x143] & 0x80);
+        memcpy(cart_head, mram, sizeof(cart_head));
+
+        power_on();
         return true;
 	} else {
         cout << "Error: problem loading rom at " << rom << endl;
@@ -44,19 +125,173 @@ bool cpu::load_rom(const char* rom) {
     return false;
 }
 
+bool cpu::load_boot_rom(const char* path) {
+    ifstream in(path, ios_base::binary | ios_base::ate);
+    if (!in.is_open()) {
+        cout << "Error: problem loading boot rom at " << path << endl;
+        return false;
+    }
+
+    std::streampos size = in.tellg();
+    if (size != 0x100 && size != 0x900) {
+        cout << "Error: boot rom " << path << " is not 256 (DMG) or 2304 (CGB) bytes" << endl;
+        return false;
+    }
+
+    in.seekg(0, ios::beg);
+    in.read(reinterpret_cast<char*>(boot_rom), size);
+    boot_rom_size = static_cast<unsigned int>(size);
+    return true;
+}
+
+// Maps the boot ROM over the cartridge, or puts the cartridge bytes back. 0x0100-0x01FF is
+// always the cartridge header.
+void cpu::map_boot_rom(bool mapped) {
+    const unsigned char* from = mapped ? boot_rom : cart_head;
+
+    memcpy(mram, from, 0x100);
+    if (boot_rom_size > 0x100) memcpy(&mram[0x200], &from[0x200], boot_rom_size - 0x200);
+    boot_rom_mapped = mapped;
+}
+
+unsigned char* cpu::cart_byte(unsigned short addr) {
+    bool covered = boot_rom_mapped && (addr < 0x100 || (addr >= 0x200 && addr < boot_rom_size));
+    return covered ? &cart_head[addr] : &mram[addr];
+}
+
+// IO registers as the DMG boot ROM leaves them. CGB differs in the few it overrides.
+struct io_init {
+    unsigned short addr;
+    unsigned char value;
+};
+
+static const io_init dmg_post_boot_io[] = {
+    { 0xFF00, 0xCF }, { 0xFF01, 0x00 }, { 0xFF02, 0x7E }, { 0xFF04, 0xAB }, { 0xFF05, 0x00 },
+    { 0xFF06, 0x00 }, { 0xFF07, 0xF8 }, { 0xFF0F, 0xE1 }, { 0xFF10, 0x80 }, { 0xFF11, 0xBF },
+    { 0xFF12, 0xF3 }, { 0xFF13, 0xFF }, { 0xFF14, 0xBF }, { 0xFF16, 0x3F }, { 0xFF17, 0x00 },
+    { 0xFF18, 0xFF }, { 0xFF19, 0xBF }, { 0xFF1A, 0x7F }, { 0xFF1B, 0xFF }, { 0xFF1C, 0x9F },
+    { 0xFF1D, 0xFF }, { 0xFF1E, 0xBF }, { 0xFF20, 0xFF }, { 0xFF21, 0x00 }, { 0xFF22, 0x00 },
+    { 0xFF23, 0xBF }, { 0xFF24, 0x77 }, { 0xFF25, 0xF3 }, { 0xFF26, 0xF1 }, { 0xFF40, 0x91 },
+    { 0xFF41, 0x85 }, { 0xFF42, 0x00 }, { 0xFF43, 0x00 }, { 0xFF44, 0x00 }, { 0xFF45, 0x00 },
+    { 0xFF46, 0xFF }, { 0xFF47, 0xFC }, { 0xFF4A, 0x00 }, { 0xFF4B, 0x00 }, { 0xFF50, 0xFF },
+    { 0xFFFF, 0x00 },
+};
+
+static const io_init cgb_post_boot_io[] = {
+    { 0xFF02, 0x7F }, { 0xFF4D, 0x7E }, { 0xFF4F, 0xFE }, { 0xFF55, 0xFF }, { 0xFF70, 0xF9 },
+};
+
+// The registers and IO the boot ROM hands over with, so a cartridge can start at 0x0100 without
+// running it. CGB games tell the hardware apart by A = 0x11.
+void cpu::post_boot_state() {
+    if (cgb) {
+        set_af(0x1180);
+        set_bc(0x0000);
+        set_de(0xFF56);
+        set_hl(0x000D);
+    } else {
+        set_af(0x01B0);
+        set_bc(0x0013);
+        set_de(0x00D8);
+        set_hl(0x014D);
+    }
+    stack_pointer = 0xFFFE;
+    prog_counter = 0x0100;
+
+    for (const io_init& r : dmg_post_boot_io) mram[r.addr] = r.value;
+    if (cgb) {
+        for (const io_init& r : cgb_post_boot_io) mram[r.addr] = r.value;
+    }
+}
+
+void cpu::reset() {
+    cycles = 0;
+    step_cycles = 0;
+    step_clocks = 0;
+    running = true;
+
+    double_speed = false;
+    rom_bank = 1;
+
+    hdma_active = false;
+    hdma_src = 0;
+    hdma_dst = 0;
+    hdma_blocks = 0;
+    dma_stall = 0;
+
+    oam_dma_start = 0;
+    oam_dma_end = 0;
+    oam_dma_source = 0;
+    update_access_checks();
+}
+
+void cpu::power_on() {
+    if (boot_rom_size == 0) {
+        post_boot_state();
+        return;
+    }
+
+    set_af(0);
+    set_bc(0);
+    set_de(0);
+    set_hl(0);
+    stack_pointer = 0;
+    prog_counter = 0;
+    map_boot_rom(true);
+}
+
+// Captures the state before the instruction at pc executes.
+inline void cpu::record_trace(unsigned short pc) {
+    trace_record& r = tracer->next();
+
+    r.cycle = cycles;
+    r.pc = pc;
+    r.sp = stack_pointer;
+    r.opcode = mram[pc];
+    r.operand[0] = mram[pc + 1];
+    r.operand[1] = mram[pc + 2];
+    r.bank = static_cast<unsigned char>(rom_bank);
+
+    r.a = registers.a;
+    r.f = registers.f;
+    r.b = registers.b;
+    r.c = registers.c;
+    r.d = registers.d;
+    r.e = registers.e;
+    r.h = registers.h;
+    r.l = registers.l;
+}
+
 void cpu::read() {
-    unsigned int opcode = static_cast<unsigned int>(mram[prog_counter]);
+    unsigned short pc = prog_counter;
+    unsigned int opcode = static_cast<unsigned int>(mram[pc]);
+    const opcode_info& info = opcode_lookup(static_cast<unsigned char>(opcode), mram[pc + 1]);
+    prog_counter_copy = pc;
+
+    // PC moves past the instruction up front; operands are read relative to pc, and jumps,
+    // calls and returns overwrite prog_counter.
+    prog_counter = pc + info.length;
+    step_cycles = info.cycles + dma_stall;
+    dma_stall = 0;
+
+    if (tracer != nullptr) record_trace(pc);
 
     switch (opcode) {
-        // NOP: Advances the program counter by 1.
+        // NOP: Does nothing.
         case 0x00: {
-            prog_counter++;
             break;
         }
 
-        // STOP: Stops the system clock and osc. circuit. if pc is 0x1000.
+        // STOP: Stops the system clock and osc. circuit. if pc is 0x1000. On CGB with KEY1 armed it
+        // switches between normal and double speed instead.
         case 0x10: {
-            if (static_cast<unsigned int>(mram[prog_counter + 1]) == 0x00) {
+            if (cgb && (mram[0xFF4D] & 0x01)) {
+                double_speed = !double_speed;
+                mram[0xFF4D] = double_speed ? 0xFE : 0x7E;
+                break;
+            }
+
+            if (static_cast<unsigned int>(mram[pc + 1]) == 0x00) {
                 running = false;
             }
             break;
@@ -64,16 +299,22 @@ void cpu::read() {
 
         // JR NZ, s8: If the Z flag is 0, then read the next signed 8 bytes. Else, move forward.
         case 0x20: {
-            char s8 = static_cast<char>(mram[prog_counter + 1]);
-            prog_counter += (!f_flags.f_zero ? s8 : 1);
+            signed char s8 = static_cast<signed char>(mram[pc + 1]);
+            if (!f_zero()) {
+                prog_counter += s8;
+                step_cycles = info.cycles_branch;
+            }
 
             break;
         }
 
         // JR NC, s8: If the CY flag is 0, then read the next signed 8 bytes. Else, move forward.
         case 0x30: {
-            char s8 = static_cast<char>(mram[prog_counter + 1]);
-            prog_counter += (!f_flags.f_carry ? s8 : 1);
+            signed char s8 = static_cast<signed char>(mram[pc + 1]);
+            if (!f_carry()) {
+                prog_counter += s8;
+                step_cycles = info.cycles_branch;
+            }
 
             break;
         }
@@ -81,7 +322,6 @@ void cpu::read() {
         // LD B, B: Loads the contents of register B into register B.
         case 0x40: {
             registers.b = registers.b;
-            prog_counter++;
 
             break;
         }
@@ -89,7 +329,6 @@ void cpu::read() {
         // LD D, B: Loads the contents of register B into register D.
         case 0x50: {
             registers.d = registers.b;
-            prog_counter++;
 
             break;
         }
@@ -97,15 +336,13 @@ void cpu::read() {
         // LD H, B: Loads the contents of register B into register H.
         case 0x60: {
             registers.h = registers.b;
-            prog_counter++;
 
             break;
         }
 
         // LD (HL), B: Store the contents of register B in the memory location specified by register pair HL.
         case 0x70: {
-            mram[get_hl()] = registers.b;
-            prog_counter++;
+            write_byte(get_hl(), registers.b);
 
             break;
         }
@@ -116,7 +353,6 @@ void cpu::read() {
             set_f(sum == 0x0, false, ((registers.a & 0xF) + (sum & 0xF) > 0xF), registers.a > sum);
 
             registers.a = sum;
-            prog_counter++;
 
             break;
         }
@@ -127,7 +363,6 @@ void cpu::read() {
             set_f(diff == 0x0, true, ((registers.a & 0xF) < (registers.b & 0xF)), registers.a < diff);
 
             registers.a = diff;
-            prog_counter++;
 
             break;
         }
@@ -139,8 +374,6 @@ void cpu::read() {
             registers.a = and_res;
             set_f(and_res == 0x0, false, true, false);
 
-            prog_counter++;
-
             break;
         }
 
@@ -151,8 +384,6 @@ void cpu::read() {
             registers.a = op_res;
             set_f(op_res == 0x0, false, false, false);
 
-            prog_counter++;
-
             break;
         }
 
@@ -163,11 +394,10 @@ void cpu::read() {
         // LD (a8), A: Store the contents of register A in the internal RAM, port register, or mode register 
         // at the address in the range 0xFF00-0xFFFF specified by the 8-bit immediate operand a8.
         case 0xE0: {
-            char a8 = static_cast<unsigned char>(mram[prog_counter + 1]);
-            short mem_loc = 0xFF00 & a8;
+            unsigned char a8 = static_cast<unsigned char>(mram[pc + 1]);
+            unsigned short mem_loc = 0xFF00 | a8;
 
-            mram[mem_loc] = registers.a;
-            prog_counter++;
+            write_byte(mem_loc, registers.a);
 
             break;
         }
@@ -176,59 +406,54 @@ void cpu::read() {
         // LD A, (a8): Load into register A the contents of the internal RAM, port register, or mode 
         // register at the address in the range 0xFF00-0xFFFF specified by the 8-bit immediate operand a8.
         case 0xF0: {
-            char a8 = static_cast<unsigned char>(mram[prog_counter + 1]);
-            short mem_loc = 0xFF00 & a8;
+            unsigned char a8 = static_cast<unsigned char>(mram[pc + 1]);
+            unsigned short mem_loc = 0xFF00 | a8;
 
-            registers.a = mram[mem_loc];
-            prog_counter++;
+            registers.a = read_byte(mem_loc);
 
             break;
         }
 
         // LD BC, d16: Load the 2 bytes of immediate data into register pair BC.
         case 0x01: {
-            char d8 = static_cast<unsigned char>(mram[prog_counter + 1]);
-            char d16 = static_cast<unsigned char>(mram[prog_counter + 2]);
+            unsigned char d8 = static_cast<unsigned char>(mram[pc + 1]);
+            unsigned char d16 = static_cast<unsigned char>(mram[pc + 2]);
 
-            short new_bc = d8 << 8 & d16;
+            unsigned short new_bc = d16 << 8 | d8;
             set_bc(new_bc);
-            prog_counter++;
 
             break;
         }
 
         // LD DE; d16: Load the 2 bytes of immediate data into register pair DE.
         case 0x11: {
-            unsigned char d8 = static_cast<unsigned char>(mram[prog_counter + 1]);
-            unsigned char d16 = static_cast<unsigned char>(mram[prog_counter + 2]);
+            unsigned char d8 = static_cast<unsigned char>(mram[pc + 1]);
+            unsigned char d16 = static_cast<unsigned char>(mram[pc + 2]);
 
-            unsigned short new_de = d8 << 8 & d16;
+            unsigned short new_de = d16 << 8 | d8;
             set_de(new_de);
-            prog_counter++;
             
             break;
         }
 
         // LD HL; d16: Load the 2 bytes of immediate data into register pair HL.
         case 0x21: {
-            unsigned char d8 = static_cast<unsigned char>(mram[prog_counter + 1]);
-            unsigned char d16 = static_cast<unsigned char>(mram[prog_counter + 2]);
+            unsigned char d8 = static_cast<unsigned char>(mram[pc + 1]);
+            unsigned char d16 = static_cast<unsigned char>(mram[pc + 2]);
 
-            unsigned short new_hl = d8 << 8 & d16;
+            unsigned short new_hl = d16 << 8 | d8;
             set_hl(new_hl);
-            prog_counter++;
             
             break;
         }
 
         // LD SP; d16: Load the 2 bytes of immediate data into register pair SP.
         case 0x31: {
-            char d8 = static_cast<unsigned char>(mram[prog_counter + 1]);
-            char d16 = static_cast<unsigned char>(mram[prog_counter + 2]);
+            unsigned char d8 = static_cast<unsigned char>(mram[pc + 1]);
+            unsigned char d16 = static_cast<unsigned char>(mram[pc + 2]);
 
-            unsigned short new_sp = d8 << 8 & d16;
+            unsigned short new_sp = d16 << 8 | d8;
             stack_pointer = new_sp;
-            prog_counter++;
             
             break;
         }
@@ -236,7 +461,6 @@ void cpu::read() {
         // LD B, C: Loads the contents of register C into register B.
         case 0x41: {
             registers.b = registers.c;
-            prog_counter++;
 
             break;
         }
@@ -244,7 +468,6 @@ void cpu::read() {
         // LD D, C: Loads the contents of register C into register D.
         case 0x51: {
             registers.d = registers.c;
-            prog_counter++;
 
             break;
         }
@@ -252,7 +475,6 @@ void cpu::read() {
         // LD H, C: Loads the contents of register C into register H.
         case 0x61: {
             registers.h = registers.c;
-            prog_counter++;
 
             break;
         }
@@ -260,8 +482,7 @@ void cpu::read() {
         // LD H, C: Store the contents of register C in the memory location 
         // specified by register pair HL.
         case 0x71: {
-            mram[get_hl()] = registers.c;
-            prog_counter++;
+            write_byte(get_hl(), registers.c);
 
             break;
         }
@@ -272,7 +493,6 @@ void cpu::read() {
             set_f(sum == 0x0, false, ((registers.a & 0xF) + (sum & 0xF) > 0xF), registers.a > sum);
 
             registers.a = sum;
-            prog_counter++;
 
             break;
         }
@@ -283,7 +503,6 @@ void cpu::read() {
             set_f(diff == 0x0, true, ((registers.a & 0xF) < (registers.c & 0xF)), registers.a < diff);
 
             registers.a = diff;
-            prog_counter++;
 
             break;
         }
@@ -295,8 +514,6 @@ void cpu::read() {
             registers.a = res;
             set_f(res == 0x0, false, true, false);
 
-            prog_counter++;
-
             break;
         }
 
@@ -307,8 +524,6 @@ void cpu::read() {
             registers.a = res;
             set_f(res == 0x0, false, false, false);
 
-            prog_counter++;
-
             break;
         }
 
@@ -318,14 +533,12 @@ void cpu::read() {
         // Add 1 to SP and load the contents from the new memory location into the upper portion of BC.
         // By the end, SP should be 2 more than its initial value.
         case 0xC1: {
-            unsigned char n8 = mram[stack_pointer];
-            unsigned char n16 = mram[stack_pointer + 1];
+            unsigned char n8 = read_byte(stack_pointer);
+            unsigned char n16 = read_byte(stack_pointer + 1);
 
             set_bc(n16 << 8 | n8);
             stack_pointer += 2;
 
-            prog_counter++;
-
             break;
         }
 
@@ -335,14 +548,12 @@ void cpu::read() {
         // Add 1 to SP and load the contents from the new memory location into the upper portion of DE.
         // By the end, SP should be 2 more than its initial value.
         case 0xD1: {
-            unsigned char n8 = mram[stack_pointer];
-            unsigned char n16 = mram[stack_pointer + 1];
+            unsigned char n8 = read_byte(stack_pointer);
+            unsigned char n16 = read_byte(stack_pointer + 1);
 
             set_de(n16 << 8 | n8);
             stack_pointer += 2;
 
-            prog_counter++;
-
             break;
         }
 
@@ -352,14 +563,12 @@ void cpu::read() {
         // Add 1 to SP and load the contents from the new memory location into the upper portion of HL.
         // By the end, SP should be 2 more than its initial value.
         case 0xE1: {
-            unsigned char n8 = mram[stack_pointer];
-            unsigned char n16 = mram[stack_pointer + 1];
+            unsigned char n8 = read_byte(stack_pointer);
+            unsigned char n16 = read_byte(stack_pointer + 1);
 
             set_hl(n16 << 8 | n8);
             stack_pointer += 2;
 
-            prog_counter++;
-
             break;
         }
 
@@ -369,29 +578,25 @@ void cpu::read() {
         // Add 1 to SP and load the contents from the new memory location into the upper portion of AF.
         // By the end, SP should be 2 more than its initial value.
         case 0xF1: {
-            unsigned char n8 = mram[stack_pointer];
-            unsigned char n16 = mram[stack_pointer + 1];
+            unsigned char n8 = read_byte(stack_pointer);
+            unsigned char n16 = read_byte(stack_pointer + 1);
 
             set_af(n16 << 8 | n8);
             stack_pointer += 2;
 
-            prog_counter++;
-
             break;
         }
 
         // LD (BC), A: Store the contents of register A in the memory location specified by register pair BC.
         case 0x02: {
-            mram[get_bc()] = registers.a;
-            prog_counter++;
+            write_byte(get_bc(), registers.a);
 
             break;
         }
 
         // LD (DE), A: Store the contents of register A in the memory location specified by register pair DE.
         case 0x12: {
-            mram[get_de()] = registers.a;
-            prog_counter++;
+            write_byte(get_de(), registers.a);
 
             break;
         }
@@ -399,9 +604,8 @@ void cpu::read() {
         // LD (HL+), A: Store the contents of register A into the memory location specified by register pair 
         // HL, and simultaneously increment the contents of HL.
         case 0x22: {
-            mram[get_hl()] = registers.a;
+            write_byte(get_hl(), registers.a);
             set_hl(get_hl() + 1);
-            prog_counter++;
 
             break;
         }
@@ -409,9 +613,8 @@ void cpu::read() {
         // LD (HL-), A: Store the contents of register A into the memory location specified by register pair 
         // HL, and simultaneously decrement the contents of HL.
         case 0x32: {
-            mram[get_hl()] = registers.a;
+            write_byte(get_hl(), registers.a);
             set_hl(get_hl() - 1);
-            prog_counter++;
 
             break;
         }
@@ -419,7 +622,6 @@ void cpu::read() {
         // LD B, D: Load the contents of register D into register B.
         case 0x42: {
             registers.b = registers.d;
-            prog_counter++;
 
             break;
         }
@@ -427,7 +629,6 @@ void cpu::read() {
         // LD D, D: Load the contents of register D into register D.
         case 0x52: {
             registers.d = registers.d;
-            prog_counter++;
 
             break;
         }
@@ -435,15 +636,13 @@ void cpu::read() {
         // LD H, D: Load the contents of register D into register H.
         case 0x62: {
             registers.h = registers.d;
-            prog_counter++;
 
             break;
         }
 
         // LD (HL), D: Store the contents of register D in the memory location specified by register pair HL.
         case 0x72: {
-            mram[get_hl()] = registers.d;
-            prog_counter++;
+            write_byte(get_hl(), registers.d);
 
             break;
         }
@@ -454,7 +653,6 @@ void cpu::read() {
             set_f(sum == 0x0, false, (registers.a & 0xF) + (sum & 0xF) > 0xF, registers.a > sum);
 
             registers.a = sum;
-            prog_counter++;
 
             break;
         }
@@ -465,7 +663,6 @@ void cpu::read() {
             set_f(diff == 0x0, true, ((registers.a & 0xF) < (registers.d & 0xF)), registers.a < diff);
 
             registers.a = diff;
-            prog_counter++;
 
             break;
         }
@@ -477,8 +674,6 @@ void cpu::read() {
             registers.a = and_res;
             set_f(and_res == 0x0, false, true, false);
 
-            prog_counter++;
-
             break;
         }
 
@@ -489,8 +684,6 @@ void cpu::read() {
             registers.a = op_res;
             set_f(op_res == 0x0, false, false, false);
 
-            prog_counter++;
-
             break;
         }
 
@@ -498,14 +691,13 @@ void cpu::read() {
         // If the Z flag is 0, then the subsequent instruction starts at address a16. If not, the contents 
         // of PC are incremented, and the next instruction following the current JP instruction is executed (as usual).
         case 0xC2: {
-            char a8 = static_cast<unsigned char>(mram[prog_counter + 1]);
-            char a16 = static_cast<unsigned char>(mram[prog_counter + 2]);
+            unsigned char a8 = static_cast<unsigned char>(mram[pc + 1]);
+            unsigned char a16 = static_cast<unsigned char>(mram[pc + 2]);
 
-            unsigned short new_a16 = a8 << 8 & a16; 
-            if (!f_flags.f_zero) {
+            unsigned short new_a16 = a16 << 8 | a8;
+            if (!f_zero()) {
                 prog_counter = new_a16;
-            } else {
-                prog_counter++;
+                step_cycles = info.cycles_branch;
             }
 
             break;
@@ -515,14 +707,13 @@ void cpu::read() {
         // If the CY flag is 0, then the subsequent instruction starts at address a16. If not, the contents 
         // of PC are incremented, and the next instruction following the current JP instruction is executed (as usual).
         case 0xD2: {
-            char a8 = static_cast<unsigned char>(mram[prog_counter + 1]);
-            char a16 = static_cast<unsigned char>(mram[prog_counter + 2]);
+            unsigned char a8 = static_cast<unsigned char>(mram[pc + 1]);
+            unsigned char a16 = static_cast<unsigned char>(mram[pc + 2]);
 
-            unsigned short new_a16 = a8 << 8 & a16; 
-            if (!f_flags.f_carry) {
+            unsigned short new_a16 = a16 << 8 | a8;
+            if (!f_carry()) {
                 prog_counter = new_a16;
-            } else {
-                prog_counter++;
+                step_cycles = info.cycles_branch;
             }
 
             break;
@@ -531,27 +722,24 @@ void cpu::read() {
         // LD (C), A: Store the contents of register A in the internal RAM, port register, or mode register at the 
         // address in the range 0xFF00-0xFFFF specified by register C.
         case 0xE2: {
-            unsigned short hram_loc = 0xFF00 & registers.c;
-            mram[hram_loc] = registers.a;
+            unsigned short hram_loc = 0xFF00 | registers.c;
+            write_byte(hram_loc, registers.a);
 
-            prog_counter++;
             break;
         }
 
         // LD A, (C): Load into register A the contents of the internal RAM, port register, or mode register at the 
         // address in the range 0xFF00-0xFFFF specified by register C.
         case 0xF2: {
-            unsigned short hram_loc = 0xFF00 & registers.c;
-            registers.a = mram[hram_loc];
+            unsigned short hram_loc = 0xFF00 | registers.c;
+            registers.a = read_byte(hram_loc);
 
-            prog_counter++;
             break;
         }
 
         // INC BC: Increment the contents of register pair BC by 1.
         case 0x03: {
             set_bc(get_bc() + 1);
-            prog_counter++;
 
             break;
         }
@@ -559,7 +747,6 @@ void cpu::read() {
         // INC DE: Increment the contents of register pair DE by 1.
         case 0x13: {
             set_de(get_de() + 1);
-            prog_counter++;
 
             break;
         }
@@ -567,7 +754,6 @@ void cpu::read() {
         // INC HL: Increment the contents of register pair HL by 1.
         case 0x23: {
             set_hl(get_hl() + 1);
-            prog_counter++;
 
             break;
         }
@@ -575,7 +761,6 @@ void cpu::read() {
         // INC SP: Increment the contents of register pair SP by 1.
         case 0x33: {
             stack_pointer++;
-            prog_counter++;
 
             break;
         }
@@ -583,7 +768,6 @@ void cpu::read() {
         // LD B, E: Load the contents of register E into register B.
         case 0x43: {
             registers.b = registers.e;
-            prog_counter++;
 
             break;
         }
@@ -591,7 +775,6 @@ void cpu::read() {
         // LD D, E: Load the contents of register E into register D.
         case 0x53: {
             registers.d = registers.e;
-            prog_counter++;
 
             break;
         }
@@ -599,15 +782,13 @@ void cpu::read() {
         // LD D, E: Load the contents of register E into register H.
         case 0x63: {
             registers.h = registers.e;
-            prog_counter++;
 
             break;
         }
         
         // LD (HL), E: Store the contents of register E in the memory location specified by register pair HL.
         case 0x73: {
-            mram[get_hl()] = registers.e;
-            prog_counter++;
+            write_byte(get_hl(), registers.e);
 
             break;
         }
@@ -618,7 +799,6 @@ void cpu::read() {
             set_f(sum == 0x0, false, (registers.a & 0xF) + (sum & 0xF) > 0xF, registers.a > sum);
 
             registers.a = sum;
-            prog_counter++;
 
             break;
         }
@@ -629,7 +809,6 @@ void cpu::read() {
             set_f(diff == 0x0, true, ((registers.a & 0xF) < (registers.e & 0xF)), registers.a < diff);
 
             registers.a = diff;
-            prog_counter++;
 
             break;
         }
@@ -641,8 +820,6 @@ void cpu::read() {
             registers.a = and_res;
             set_f(and_res == 0x0, false, true, false);
 
-            prog_counter++;
-
             break;
         }
 
@@ -653,18 +830,16 @@ void cpu::read() {
             registers.a = op_res;
             set_f(op_res == 0x0, false, false, false);
 
-            prog_counter++;
-
             break;
         }
 
         // JP a16: Load the 16-bit immediate operand a16 into the program counter (PC). a16 specifies the 
         // address of the subsequently executed instruction.
         case 0xC3: {
-            char a8 = static_cast<unsigned char>(mram[prog_counter + 1]);
-            char a16 = static_cast<unsigned char>(mram[prog_counter + 2]);
+            unsigned char a8 = static_cast<unsigned char>(mram[pc + 1]);
+            unsigned char a16 = static_cast<unsigned char>(mram[pc + 2]);
 
-            unsigned short new_a16 = a8 << 8 & a16; 
+            unsigned short new_a16 = a16 << 8 | a8;
             prog_counter = new_a16;
 
             break;
@@ -676,10 +851,9 @@ void cpu::read() {
         // INC B: Increment the contents of register B by 1.
         case 0x04: {
             unsigned char sum = registers.b + 1;
-            set_f(sum == 0x0, false, ((registers.b & 0xF) + (sum & 0xF) > 0xF), f_flags.f_carry);
+            set_f(sum == 0x0, false, ((registers.b & 0xF) + (sum & 0xF) > 0xF), f_carry());
 
             registers.b = sum;
-            prog_counter++;
 
             break;
         }
@@ -687,10 +861,9 @@ void cpu::read() {
         // INC D: Increment the contents of register D by 1.
         case 0x14: {
             unsigned char sum = registers.d + 1;
-            set_f(sum == 0x0, false, ((registers.d & 0xF) + (sum & 0xF) > 0xF), f_flags.f_carry);
+            set_f(sum == 0x0, false, ((registers.d & 0xF) + (sum & 0xF) > 0xF), f_carry());
 
             registers.d = sum;
-            prog_counter++;
 
             break;
         }
@@ -698,21 +871,20 @@ void cpu::read() {
         // INC D: Increment the contents of register H by 1.
         case 0x24: {
             unsigned char sum = registers.h + 1;
-            set_f(sum == 0x0, false, ((registers.h & 0xF) + (sum & 0xF) > 0xF), f_flags.f_carry);
+            set_f(sum == 0x0, false, ((registers.h & 0xF) + (sum & 0xF) > 0xF), f_carry());
 
             registers.h = sum;
-            prog_counter++;
 
             break;
         }
 
         // INC (HL): Increment the contents of memory specified by register pair HL by 1.
         case 0x34: {
-            unsigned char sum = mram[get_hl()] + 1;
-            set_f(sum == 0x0, false, ((mram[get_hl()] & 0xF) + (sum & 0xF) > 0xF), f_flags.f_carry);
+            unsigned char value = read_byte(get_hl());
+            unsigned char sum = value + 1;
+            set_f(sum == 0x0, false, ((value & 0xF) + (sum & 0xF) > 0xF), f_carry());
 
-            mram[get_hl()] = sum;
-            prog_counter++;
+            write_byte(get_hl(), sum);
 
             break;
         }
@@ -720,7 +892,6 @@ void cpu::read() {
         // LD B, H: Load the contents of register H into register B.
         case 0x44: {
             registers.b = registers.h;
-            prog_counter++;
 
             break;
         }
@@ -728,7 +899,6 @@ void cpu::read() {
         // LD D, H: Load the contents of register H into register D.
         case 0x54: {
             registers.d = registers.h;
-            prog_counter++;
 
             break;
         }
@@ -736,15 +906,13 @@ void cpu::read() {
         // LD H, H: Load the contents of register H into register H.
         case 0x64: {
             registers.h = registers.h;
-            prog_counter++;
 
             break;
         }
 
         // LD (HL), H: Store the contents of register H in the memory location specified by register pair HL.
         case 0x74: {
-            mram[get_hl()] = registers.h;
-            prog_counter++;
+            write_byte(get_hl(), registers.h);
 
             break;
         }
@@ -755,7 +923,6 @@ void cpu::read() {
             set_f(sum == 0x0, false, ((registers.a & 0xF) + (sum & 0xF) > 0xF), registers.a > sum);
 
             registers.a = sum;
-            prog_counter++;
 
             break;
         }
@@ -766,7 +933,6 @@ void cpu::read() {
             set_f(diff == 0x0, true, ((registers.a & 0xF) < (registers.h & 0xF)), registers.a < diff);
 
             registers.a = diff;
-            prog_counter++;
 
             break;
         }
@@ -778,8 +944,6 @@ void cpu::read() {
             registers.a = and_res;
             set_f(and_res == 0x0, false, true, false);
 
-            prog_counter++;
-
             break;
         }
 
@@ -790,8 +954,6 @@ void cpu::read() {
             registers.a = op_res;
             set_f(op_res == 0x0, false, false, false);
 
-            prog_counter++;
-
             break;
         }
 
@@ -802,10 +964,9 @@ void cpu::read() {
         // DEC B: Decrement the contents of register B by 1.
         case 0x05: {
             unsigned char diff = registers.b - 1;
-            set_f(diff == 0x0, true, ((registers.b & 0xF) + (diff & 0xF) > 0xF), f_flags.f_carry);
+            set_f(diff == 0x0, true, ((registers.b & 0xF) + (diff & 0xF) > 0xF), f_carry());
 
             registers.b = diff;
-            prog_counter++;
 
             break;
         }
@@ -813,10 +974,9 @@ void cpu::read() {
         // DEC D: Decrement the contents of register D by 1.
         case 0x15: {
             unsigned char diff = registers.d - 1;
-            set_f(diff == 0x0, true, ((registers.d & 0xF) + (diff & 0xF) > 0xF), f_flags.f_carry);
+            set_f(diff == 0x0, true, ((registers.d & 0xF) + (diff & 0xF) > 0xF), f_carry());
             
             registers.d = diff;
-            prog_counter++;
 
             break;
         }
@@ -824,21 +984,20 @@ void cpu::read() {
         // DEC H: Decrement the contents of register H by 1.
         case 0x25: {
             unsigned char diff = registers.h - 1;
-            set_f(diff == 0x0, true, ((registers.h & 0xF) + (diff & 0xF) > 0xF), f_flags.f_carry);
+            set_f(diff == 0x0, true, ((registers.h & 0xF) + (diff & 0xF) > 0xF), f_carry());
             
             registers.h = diff;
-            prog_counter++;
 
             break;
         }
 
         // DEC (HL): Decrement the contents of memory specified by register pair HL by 1.
         case 0x35: {
-            unsigned char diff = mram[get_hl()] - 1;
-            set_f(diff == 0x0, true, ((mram[get_hl()] & 0xF) + (diff & 0xF) > 0xF), f_flags.f_carry);
+            unsigned char value = read_byte(get_hl());
+            unsigned char diff = value - 1;
+            set_f(diff == 0x0, true, ((value & 0xF) + (diff & 0xF) > 0xF), f_carry());
             
-            mram[get_hl()] = diff;
-            prog_counter++;
+            write_byte(get_hl(), diff);
 
             break;
         }
@@ -846,7 +1005,6 @@ void cpu::read() {
         // LD B, L: Loads the contents of register L into register B.
         case 0x45: {
             registers.b = registers.l;
-            prog_counter++;
 
             break;
         }
@@ -854,7 +1012,6 @@ void cpu::read() {
         // LD D, L: Loads the contents of register L into register D.
         case 0x55: {
             registers.d = registers.l;
-            prog_counter++;
 
             break;
         }
@@ -862,15 +1019,13 @@ void cpu::read() {
         // LD H, L: Loads the contents of register L into register H.
         case 0x65: {
             registers.h = registers.l;
-            prog_counter++;
 
             break;
         }
 
         // LD D, L: Store the contents of register L in the memory location specified by register pair HL.
         case 0x75: {
-            mram[get_hl()] = registers.l;
-            prog_counter++;
+            write_byte(get_hl(), registers.l);
 
             break;
         }
@@ -881,7 +1036,6 @@ void cpu::read() {
             set_f(sum == 0x0, false, ((registers.a & 0xF) + (sum & 0xF) > 0xF), registers.a > sum);
 
             registers.a = sum;
-            prog_counter++;
 
             break;
         }
@@ -892,7 +1046,6 @@ void cpu::read() {
             set_f(diff == 0x0, true, ((registers.a & 0xF) < (registers.l & 0xF)), registers.a < diff);
 
             registers.a = diff;
-            prog_counter++;
 
             break;
         }
@@ -904,8 +1057,6 @@ void cpu::read() {
             registers.a = and_res;
             set_f(and_res == 0x0, false, true, false);
 
-            prog_counter++;
-
             break;
         }
 
@@ -916,8 +1067,6 @@ void cpu::read() {
             registers.a = op_res;
             set_f(op_res == 0x0, false, false, false);
 
-            prog_counter++;
-
             break;
         }
 
@@ -929,86 +1078,81 @@ void cpu::read() {
 
         // LD B, d8: Load the 8-bit immediate operand d8 into register B.
         case 0x06: {
-            unsigned char d8 = mram[prog_counter + 1];
+            unsigned char d8 = mram[pc + 1];
             registers.b = d8;
 
-            prog_counter++;
             break;
         }
 
         // LD D, d8: Load the 8-bit immediate operand d8 into register D.
         case 0x16: {
-            unsigned char d8 = mram[prog_counter + 1];
+            unsigned char d8 = mram[pc + 1];
             registers.d = d8;
 
-            prog_counter++;
             break;
         }
 
         // LD H, d8: Load the 8-bit immediate operand d8 into register H.
         case 0x26: {
-            unsigned char d8 = mram[prog_counter + 1];
+            unsigned char d8 = mram[pc + 1];
             registers.h = d8;
 
-            prog_counter++;
             break;
         }
 
         // LD (HL), d8: Store the contents of 8-bit immediate operand d8 in the memory location specified by register pair HL.
         case 0x36: {
-            unsigned char d8 = mram[prog_counter + 1];
-            mram[get_hl()] = d8;
+            unsigned char d8 = mram[pc + 1];
+            write_byte(get_hl(), d8);
 
-            prog_counter++;
             break;
         }
 
         // LD B, (HL): Load the 8-bit contents of memory specified by register pair HL into register B.
         case 0x46: {
-            registers.b = mram[get_hl()];
+            registers.b = read_byte(get_hl());
 
-            prog_counter++;
             break;
         }
 
         // LD D, (HL): Load the 8-bit contents of memory specified by register pair HL into register D.
         case 0x56: {
-            registers.d = mram[get_hl()];
+            registers.d = read_byte(get_hl());
 
-            prog_counter++;
             break;
         }
 
         // LD H, (HL): Load the 8-bit contents of memory specified by register pair HL into register H.
         case 0x66: {
-            registers.h = mram[get_hl()];
+            registers.h = read_byte(get_hl());
 
-            prog_counter++;
             break;
         }
 
-        // TODO: HALT
-        case 0x76: { break; }
+        // HALT: There is no interrupt dispatch yet, so PC stays on the HALT.
+        case 0x76: {
+            prog_counter = pc;
+            break;
+        }
 
         // ADD A, (HL): Add the contents of memory specified by register pair HL to the contents 
         // of register A, and store the results in register A.
         case 0x86: {
-            unsigned char sum = registers.a + mram[get_hl()];
+            unsigned char sum = registers.a + read_byte(get_hl());
             set_f(sum == 0x0, false, ((registers.a & 0xF) + (sum & 0xF) > 0xF), registers.a > sum);
 
             registers.a = sum;
-            prog_counter++;
 
             break;
         }
 
         // SUB (HL): Subtract the contents of register L from the contents of register A, and store the results in register A.
         case 0x96: { 
-            unsigned char diff = registers.a - mram[get_hl()];
-            set_f(diff == 0x0, true, ((registers.a & 0xF) < (mram[get_hl()] & 0xF)), registers.a < diff);
+            unsigned char value = read_byte(get_hl());
+            unsigned char diff = registers.a - value;
+            set_f(diff == 0x0, true, ((registers.a & 0xF) < (value & 0xF)), registers.a < diff);
 
             registers.a = diff;
-            prog_counter++;
 
             break;
         }
@@ -1016,35 +1160,30 @@ void cpu::read() {
         // AND (HL): Take the logical AND for each bit of the contents of memory specified by register 
         // pair HL and the contents of register A, and store the results in register A.
         case 0xA6: {
-            unsigned char and_res = registers.a & mram[get_hl()];
+            unsigned char and_res = registers.a & read_byte(get_hl());
             registers.a = and_res;
             set_f(and_res == 0x0, false, true, false);
 
-            prog_counter++;
-
             break;
         }
 
         // OR (HL): Take the logical OR for each bit of the contents of memory specified by register 
         // pair HL and the contents of register A, and store the results in register A.
         case 0xB6: {
-            unsigned char op_res = (registers.a | mram[get_hl()]);
+            unsigned char op_res = (registers.a | read_byte(get_hl()));
             registers.a = op_res;
             set_f(op_res == 0x0, false, false, false);
 
-            prog_counter++;
-
             break;
         }
 
         // ADD A, d8: Add the contents of the 8-bit immediate operand d8 to the 
         // contents of register A, and store the results in register A.
         case 0xC6: {
-            unsigned char sum = registers.a + mram[prog_counter + 1];
+            unsigned char sum = registers.a + mram[pc + 1];
             set_f(sum == 0x0, false, ((registers.a & 0xF) + (sum & 0xF) > 0xF), registers.a > sum);
 
             registers.a = sum;
-            prog_counter++;
 
             break;
         }
@@ -1052,11 +1191,10 @@ void cpu::read() {
         // SUB d8: Subtract the contents of the 8-bit immediate operand d8 from the 
         // contents of register A, and store the results in register A.
         case 0xD6: {
-            unsigned char diff = registers.a - mram[prog_counter + 1];
-            set_f(diff == 0x0, true, ((registers.a & 0xF) < (mram[prog_counter + 1] & 0xF)), registers.a < diff);
+            unsigned char diff = registers.a - mram[pc + 1];
+            set_f(diff == 0x0, true, ((registers.a & 0xF) < (mram[pc + 1] & 0xF)), registers.a < diff);
 
             registers.a = diff;
-            prog_counter++;
 
             break;
         }
@@ -1064,24 +1202,20 @@ void cpu::read() {
         // AND d8: Take the logical AND for each bit of the contents of 8-bit immediate
         // operand d8 and the contents of register A, and store the results in register A.
         case 0xE6: {
-            unsigned char and_res = registers.a & mram[prog_counter + 1];
+            unsigned char and_res = registers.a & mram[pc + 1];
             registers.a = and_res;
             set_f(and_res == 0x0, false, true, false);
 
-            prog_counter++;
-
             break;
         }
 
         // OR d8: Take the logical OR for each bit of the contents of the 8-bit immediate 
         // operand d8 and the contents of register A, and store the results in register A.
         case 0xF6: {
-            unsigned char op_res = (registers.a | mram[prog_counter + 1]);
+            unsigned char op_res = (registers.a | mram[pc + 1]);
             registers.a = op_res;
             set_f(op_res == 0x0, false, false, false);
 
-            prog_counter++;
-
             break;
         }
 
@@ -1094,11 +1228,9 @@ void cpu::read() {
             sh *= 2;
 
             sh += (sh >> 8);
-            f_flags.f_carry = sh >> 8;
-            build_f();
+            set_f_carry(sh >> 8);
 
             registers.a = static_cast<unsigned char>(sh);
-            prog_counter++;
             break;
         }
 
@@ -1110,12 +1242,10 @@ void cpu::read() {
             unsigned short sh = static_cast<unsigned short>(registers.a);
             sh *= 2;
 
-            sh += f_flags.f_carry ? 1 : 0;
-            f_flags.f_carry = sh >> 8;
-            build_f();
+            sh += f_carry() ? 1 : 0;
+            set_f_carry(sh >> 8);
 
             registers.a = static_cast<unsigned char>(sh);
-            prog_counter++;
             break;
         }
 
@@ -1124,15 +1254,15 @@ void cpu::read() {
 
         // SCF: Set the carry flag CY.
         case 0x37: {
-            f_flags.f_carry = true;
-            build_f();
+            set_f_carry(true);
+
+            break;
         }
 
         // LD B, A: Load the contents of register A into register B.
         case 0x47: {
             registers.b = registers.a;
 
-            prog_counter++;
             break;
         }
 
@@ -1140,7 +1270,6 @@ void cpu::read() {
         case 0x57: {
             registers.d = registers.a;
 
-            prog_counter++;
             break;
         }
 
@@ -1148,15 +1277,13 @@ void cpu::read() {
         case 0x67: {
             registers.h = registers.a;
 
-            prog_counter++;
             break;
         }
 
         // LD (HL), A: Store the contents of register A in the memory location specified by register pair HL.
         case 0x77: {
-            mram[get_hl()] = registers.a;
+            write_byte(get_hl(), registers.a);
 
-            prog_counter++;
             break;
         }
 
@@ -1166,7 +1293,6 @@ void cpu::read() {
             set_f(sum == 0x0, false, ((registers.a & 0xF) + (sum & 0xF) > 0xF), registers.a > sum);
 
             registers.a = sum;
-            prog_counter++;
 
             break;
         }
@@ -1177,7 +1303,6 @@ void cpu::read() {
             set_f(diff == 0x0, true, ((registers.a & 0xF) < (registers.a & 0xF)), registers.a < diff);
 
             registers.a = diff;
-            prog_counter++;
 
             break;
         }
@@ -1189,8 +1314,6 @@ void cpu::read() {
             registers.a = and_res;
             set_f(and_res == 0x0, false, true, false);
 
-            prog_counter++;
-
             break;
         }
 
@@ -1201,8 +1324,6 @@ void cpu::read() {
             registers.a = op_res;
             set_f(op_res == 0x0, false, false, false);
 
-            prog_counter++;
-
             break;
         }
 
@@ -1211,10 +1332,10 @@ void cpu::read() {
         // specified by the new content of PC (as usual).
         case 0xC7: {
             stack_pointer--;
-            mram[stack_pointer] = prog_counter >> 8;
+            write_byte(stack_pointer, prog_counter >> 8);
 
             stack_pointer--;
-            mram[stack_pointer] = prog_counter & 0x00ff;
+            write_byte(stack_pointer, prog_counter & 0x00ff);
             
             prog_counter = 0x00;
             break;
@@ -1225,10 +1346,10 @@ void cpu::read() {
         // specified by the new content of PC (as usual).
         case 0xD7: {
             stack_pointer--;
-            mram[stack_pointer] = prog_counter >> 8;
+            write_byte(stack_pointer, prog_counter >> 8);
 
             stack_pointer--;
-            mram[stack_pointer] = prog_counter & 0x00ff;
+            write_byte(stack_pointer, prog_counter & 0x00ff);
             
             prog_counter = 0x10;
             break;
@@ -1239,10 +1360,10 @@ void cpu::read() {
         // specified by the new content of PC (as usual).
         case 0xE7: {
             stack_pointer--;
-            mram[stack_pointer] = prog_counter >> 8;
+            write_byte(stack_pointer, prog_counter >> 8);
 
             stack_pointer--;
-            mram[stack_pointer] = prog_counter & 0x00ff;
+            write_byte(stack_pointer, prog_counter & 0x00ff);
             
             prog_counter = 0x20;
             break;
@@ -1253,10 +1374,10 @@ void cpu::read() {
         // specified by the new content of PC (as usual).
         case 0xF7: {
             stack_pointer--;
-            mram[stack_pointer] = prog_counter >> 8;
+            write_byte(stack_pointer, prog_counter >> 8);
 
             stack_pointer--;
-            mram[stack_pointer] = prog_counter & 0x00ff;
+            write_byte(stack_pointer, prog_counter & 0x00ff);
             
             prog_counter = 0x30;
             break;
@@ -1266,9 +1387,9 @@ void cpu::read() {
         // immediate operand a16, and store the upper byte of SP at address a16 + 1.
         case 0x08: { break; }
 
-        // JR s8: Jump s8 steps from the current address in the program counter (PC). (Jump relative.)
+        // JR s8: Jump s8 steps from the address of the instruction following JR. (Jump relative.)
         case 0x18: {
-            char s8 = static_cast<signed char>(mram[prog_counter + 1]);
+            signed char s8 = static_cast<signed char>(mram[pc + 1]);
             prog_counter += s8;
 
             break;
@@ -1277,8 +1398,11 @@ void cpu::read() {
         // JR Z, s8: If the Z flag is 1, jump s8 steps from the current address stored in the program counter (PC). 
         // If not, the instruction following the current JP instruction is executed (as usual).
         case 0x28: {
-            char s8 = static_cast<signed char>(mram[prog_counter + 1]);
-            prog_counter += f_flags.f_zero ? s8 : 1;
+            signed char s8 = static_cast<signed char>(mram[pc + 1]);
+            if (f_zero()) {
+                prog_counter += s8;
+                step_cycles = info.cycles_branch;
+            }
 
             break;
         }
@@ -1286,8 +1410,11 @@ void cpu::read() {
         // JR CY, s8: If the CY flag is 1, jump s8 steps from the current address stored in the program counter (PC). 
         // If not, the instruction following the current JP instruction is executed (as usual).
         case 0x38: {
-            char s8 = static_cast<signed char>(mram[prog_counter + 1]);
-            prog_counter += f_flags.f_carry ? s8 : 1;
+            signed char s8 = static_cast<signed char>(mram[pc + 1]);
+            if (f_carry()) {
+                prog_counter += s8;
+                step_cycles = info.cycles_branch;
+            }
 
             break;
         }
@@ -1296,7 +1423,6 @@ void cpu::read() {
         case 0x48: {
             registers.c = registers.b;
 
-            prog_counter++;
             break;
         }
 
@@ -1304,7 +1430,6 @@ void cpu::read() {
         case 0x58: {
             registers.e = registers.b;
 
-            prog_counter++;
             break;
         }
 
@@ -1312,7 +1437,6 @@ void cpu::read() {
         case 0x68: {
             registers.l = registers.b;
 
-            prog_counter++;
             break;
         }
 
@@ -1320,7 +1444,6 @@ void cpu::read() {
         case 0x78: {
             registers.a = registers.b;
 
-            prog_counter++;
             break;
         }
 
@@ -1328,12 +1451,11 @@ void cpu::read() {
         // store the results in register A.
         case 0x88: {
             unsigned char sum = registers.a + registers.b;
-            if (f_flags.f_carry) sum += 1;
+            if (f_carry()) sum += 1;
 
             set_f(sum == 0x0, false, ((registers.a & 0xF) + (sum & 0xF) > 0xF), registers.a > sum);
 
             registers.a = sum;
-            prog_counter++;
 
             break;
         }
@@ -1342,11 +1464,10 @@ void cpu::read() {
         // and store the results in register A.
         case 0x98: {
             unsigned char diff = registers.a - registers.b;
-            if (f_flags.f_carry) diff -= 1;
+            if (f_carry()) diff -= 1;
             set_f(diff == 0x0, true, ((registers.a & 0xF) < (registers.b & 0xF)), registers.a < diff);
 
             registers.a = diff;
-            prog_counter++;
 
             break;
         }
@@ -1358,8 +1479,6 @@ void cpu::read() {
             registers.a = xor_res;
             set_f(xor_res == 0x0, false, false, false);
 
-            prog_counter++;
-
             break;
         }
 
@@ -1370,8 +1489,6 @@ void cpu::read() {
             unsigned char diff = registers.a - registers.b;
             set_f(diff == 0x0, true, ((registers.a & 0xF) < (registers.b & 0xF)), registers.a < diff);
 
-            prog_counter++;
-
             break;
         }
 
@@ -1382,13 +1499,12 @@ void cpu::read() {
         // ADD SP, s8: Add the contents of the 8-bit signed (2's complement) immediate operand s8 and 
         // the stack pointer SP and store the results in SP.
         case 0xE8: {
-            char s8 = static_cast<char>(mram[prog_counter + 1]);
+            char s8 = static_cast<char>(mram[pc + 1]);
             unsigned short sp_sum = stack_pointer + s8;
             
             set_f(false, false, ((stack_pointer & 0xF) + (sp_sum & 0xF) > 0xF), stack_pointer > sp_sum);
 
             stack_pointer = sp_sum;
-            prog_counter++;
 
             break;
         }
@@ -1396,13 +1512,12 @@ void cpu::read() {
         // LD HL, SP+s8: Add the 8-bit signed operand s8 (values -128 to +127) to the stack pointer SP, 
         // and store the result in register pair HL.
         case 0xF8: {
-            signed char s8 = static_cast<signed char>(mram[prog_counter + 1]);
+            signed char s8 = static_cast<signed char>(mram[pc + 1]);
             unsigned short sp_sum = stack_pointer + s8;
             
             set_f(false, false, ((stack_pointer & 0xF) + (sp_sum & 0xF) > 0xF), stack_pointer > sp_sum);
             set_hl(sp_sum);
             
-            prog_counter++;
 
             break;
         }
@@ -1412,10 +1527,10 @@ void cpu::read() {
         // specified by the new content of PC (as usual).
         case 0xCF: {
             stack_pointer--;
-            mram[stack_pointer] = prog_counter >> 8;
+            write_byte(stack_pointer, prog_counter >> 8);
 
             stack_pointer--;
-            mram[stack_pointer] = prog_counter & 0x00ff;
+            write_byte(stack_pointer, prog_counter & 0x00ff);
             
             prog_counter = 0x08;
             break;
@@ -1426,10 +1541,10 @@ void cpu::read() {
         // specified by the new content of PC (as usual).
         case 0xDF: {
             stack_pointer--;
-            mram[stack_pointer] = prog_counter >> 8;
+            write_byte(stack_pointer, prog_counter >> 8);
 
             stack_pointer--;
-            mram[stack_pointer] = prog_counter & 0x00ff;
+            write_byte(stack_pointer, prog_counter & 0x00ff);
             
             prog_counter = 0x18;
             break;
@@ -1440,10 +1555,10 @@ void cpu::read() {
         // specified by the new content of PC (as usual).
         case 0xEF: {
             stack_pointer--;
-            mram[stack_pointer] = prog_counter >> 8;
+            write_byte(stack_pointer, prog_counter >> 8);
 
             stack_pointer--;
-            mram[stack_pointer] = prog_counter & 0x00ff;
+            write_byte(stack_pointer, prog_counter & 0x00ff);
             
             prog_counter = 0x28;
             break;
@@ -1454,81 +1569,234 @@ void cpu::read() {
         // specified by the new content of PC (as usual).
         case 0xFF: {
             stack_pointer--;
-            mram[stack_pointer] = prog_counter >> 8;
+            write_byte(stack_pointer, prog_counter >> 8);
 
             stack_pointer--;
-            mram[stack_pointer] = prog_counter & 0x00ff;
+            write_byte(stack_pointer, prog_counter & 0x00ff);
 
             prog_counter = 0x38;
             break;
         }
 
         default: {
-            cout << std::hex << "unknown opcode " << opcode << endl;
+            unknown_opcodes++;
+            if (report_unknown) cout << std::hex << "unknown opcode " << opcode << std::dec << endl;
             break;
         }
     }
+
+    step_clocks = step_cycles >> double_speed;
+    cycles += step_clocks;
+    instructions++;
+    if (prof != nullptr) prof->record(pc, rom_bank, step_cycles);
+    if (debug != nullptr) debug->after_instruction(prog_counter);
 }
 
-short cpu::get_af() {
-    unsigned short sh_af = registers.a << 8;
-    sh_af |= registers.f;
-    return sh_af;
+void cpu::io_write(unsigned short addr, unsigned char value) {
+    io_writes++;
+
+    if (addr >= 0xFF10 && addr <= 0xFF3F && sound != nullptr) {
+        sound->write(addr, value);
+        return;
+    }
+
+    if ((addr == 0xFF01 || addr == 0xFF02) && port != nullptr) {
+        port->write(addr, value);
+        return;
+    }
+
+    if (addr == 0xFF46) {
+        mram[addr] = value;
+        oam_dma(value);
+        return;
+    }
+
+    // The boot ROM unmaps itself as its last instruction; it can't be mapped back in.
+    if (addr == 0xFF50 && boot_rom_mapped && value != 0) {
+        map_boot_rom(false);
+        mram[addr] = 0xFF;
+        return;
+    }
+
+    if (cgb) {
+        switch (addr) {
+            // KEY1: only the "prepare speed switch" bit is writable.
+            case 0xFF4D:
+                mram[addr] = (mram[addr] & 0x80) | 0x7E | (value & 0x01);
+                return;
+
+            case 0xFF4F:
+                select_vram(value & 0x01);
+                return;
+
+            case 0xFF51: case 0xFF52: case 0xFF53: case 0xFF54:
+                mram[addr] = value;
+                return;
+
+            // HDMA5: bit 7 clear copies (value + 1) * 16 bytes now, or cancels an HBlank
+            // transfer in progress; bit 7 set starts one that copies 16 bytes per HBlank.
+            case 0xFF55: {
+                if (hdma_active && !(value & 0x80)) {
+                    hdma_active = false;
+                    mram[0xFF55] = 0x80 | (hdma_blocks - 1);
+                    return;
+                }
+
+                hdma_src = ((mram[0xFF51] << 8) | mram[0xFF52]) & 0xFFF0;
+                hdma_dst = 0x8000 | (((mram[0xFF53] << 8) | mram[0xFF54]) & 0x1FF0);
+                hdma_blocks = (value & 0x7F) + 1;
+
+                if (value & 0x80) {
+                    hdma_active = true;
+                    mram[0xFF55] = static_cast<unsigned char>(hdma_blocks - 1);
+                    if (!(mram[0xFF40] & 0x80)) hblank_dma();
+                    return;
+                }
+
+                // The CPU is halted for 32 system clocks per block.
+                step_cycles += hdma_blocks * (32u << double_speed);
+                dma_block_copy(hdma_blocks);
+                mram[0xFF55] = 0xFF;
+                return;
+            }
+
+            case 0xFF68: case 0xFF69: case 0xFF6A: case 0xFF6B:
+                palette_write(addr, value);
+                return;
+
+            case 0xFF70:
+                select_wram(value & 0x07);
+                return;
+        }
+    }
+
+    mram[addr] = value;
 }
 
-void cpu::set_af(unsigned short sh_af) {
-    registers.a = static_cast<unsigned char>((sh_af & 0xff00) >> 8);
-    registers.f = static_cast<unsigned char>(sh_af & 0x00ff);
+// One block copy into OAM, then a bus-lock window of 160 M-cycles. Sources from 0xE000 up read
+// the echo of work RAM, as on hardware.
+void cpu::oam_dma(unsigned char page) {
+    unsigned short source = static_cast<unsigned short>(page << 8);
+    if (source >= 0xE000) source -= 0x2000;
+
+    memcpy(&mram[0xFE00], &mram[source], 0xA0);
+
+    oam_dma_source = source;
+    oam_dma_start = cycles;
+    oam_dma_end = cycles + (640u >> double_speed);
+    update_access_checks();
 }
 
-short cpu::get_bc() {
-    unsigned short sh_bc = registers.b << 8;
-    sh_bc |= registers.c;
-    return sh_bc;
+void cpu::update_access_checks() {
+    checked_until = debug != nullptr && debug->watching() ? ~0ull : oam_dma_end;
 }
 
-void cpu::set_bc(unsigned short sh_bc) {
-    registers.b = static_cast<unsigned char>((sh_bc & 0xff00) >> 8);
-    registers.c = static_cast<unsigned char>(sh_bc & 0x00ff);
+unsigned char cpu::checked_read(unsigned short addr) {
+    if (debug != nullptr && debug->page_watched(addr, debugger::reads)) debug->check_access(addr, debugger::reads);
+    if (cycles < oam_dma_end && addr < 0xFF00) return dma_conflict_read(addr);
+    return mram[addr];
 }
 
-short cpu::get_de() {
-    unsigned short sh_de = registers.d << 8;
-    sh_de |= registers.e;
-    return sh_de;
+void cpu::checked_write(unsigned short addr, unsigned char value) {
+    if (debug != nullptr && debug->page_watched(addr, debugger::writes)) debug->check_access(addr, debugger::writes);
+    // HRAM is never blocked by the DMA.
+    if (is_io(addr)) io_write(addr, value);
+    else if (cycles < oam_dma_end && addr < 0xFF00) dma_conflict_write(addr, value);
+    else mram[addr] = value;
 }
 
-void cpu::set_de(unsigned short sh_de) {
-    registers.d = static_cast<unsigned char>((sh_de & 0xff00) >> 8);
-    registers.e = static_cast<unsigned char>(sh_de & 0x00ff);
+// 0: the external bus (cartridge, and work RAM on DMG), 1: VRAM, 2: CGB work RAM, 3: OAM.
+unsigned int cpu::bus_of(unsigned short addr) const {
+    if (addr >= 0xFE00) return 3;
+    if (addr >= 0x8000 && addr < 0xA000) return 1;
+    if (cgb && addr >= 0xC000) return 2;
+    return 0;
 }
 
-short cpu::get_hl() {
-    unsigned short sh_hl = registers.h << 8;
-    sh_hl |= registers.l;
-    return sh_hl;
+// During OAM DMA, OAM reads 0xFF, and a read on the bus the DMA is reading from returns the
+// byte being transferred at that moment. Other buses are unaffected.
+unsigned char cpu::dma_conflict_read(unsigned short addr) {
+    unsigned int bus = bus_of(addr);
+    if (bus == 3) return 0xFF;
+    if (bus != bus_of(oam_dma_source)) return mram[addr];
+
+    unsigned int index = static_cast<unsigned int>((cycles - oam_dma_start) >> (2 - double_speed));
+    return mram[oam_dma_source + index];
 }
 
-void cpu::set_hl(unsigned short sh_hl) {
-    registers.h = static_cast<unsigned char>((sh_hl & 0xff00) >> 8);
-    registers.l = static_cast<unsigned char>(sh_hl & 0x00ff);
+// Writes to OAM or to the bus the DMA is using are lost.
+void cpu::dma_conflict_write(unsigned short addr, unsigned char value) {
+    unsigned int bus = bus_of(addr);
+    if (bus == 3 || bus == bus_of(oam_dma_source)) return;
+    mram[addr] = value;
 }
 
-void cpu::set_f(bool fz, bool fs, bool fh, bool fcy) {
-    f_flags.f_zero = fz;
-    f_flags.f_subtract = fs;
-    f_flags.f_half_carry = fh;
-    f_flags.f_carry = fcy;
+void cpu::select_vram(unsigned int bank) {
+    if (bank != vram_select) {
+        memcpy(&vram[vram_select * 0x2000], &mram[0x8000], 0x2000);
+        memcpy(&mram[0x8000], &vram[bank * 0x2000], 0x2000);
+        vram_select = bank;
+    }
+    mram[0xFF4F] = static_cast<unsigned char>(0xFE | bank);
+}
 
-    build_f();
+// SVBK selects WRAM bank 1-7 at 0xD000; 0 also selects 1. Bank 0 at 0xC000 never moves.
+void cpu::select_wram(unsigned int bank) {
+    if (bank == 0) bank = 1;
+    if (bank != wram_select) {
+        memcpy(&wram[wram_select * 0x1000], &mram[0xD000], 0x1000);
+        memcpy(&mram[0xD000], &wram[bank * 0x1000], 0x1000);
+        wram_select = bank;
+    }
+    mram[0xFF70] = static_cast<unsigned char>(0xF8 | bank);
+}
+
+// Copies blocks * 16 bytes from hdma_src into the selected VRAM bank at hdma_dst, which is
+// resident in mram, as at most two runs (the destination wraps within VRAM).
+void cpu::dma_block_copy(unsigned int blocks) {
+    unsigned int remaining = blocks * 16;
+
+    while (remaining > 0) {
+        unsigned int dst = hdma_dst;
+        unsigned int run = remaining;
+        if (run > 0xA000 - dst) run = 0xA000 - dst;
+        if (run > 0x10000u - hdma_src) run = 0x10000u - hdma_src;
+
+        memmove(&mram[dst], &mram[hdma_src], run);
+
+        hdma_src = static_cast<unsigned short>(hdma_src + run);
+        hdma_dst = static_cast<unsigned short>(0x8000 | ((dst + run) & 0x1FFF));
+        remaining -= run;
+    }
 }
 
-void cpu::build_f() {
-    unsigned char new_f = 0b11110000;
-    if (!f_flags.f_zero) new_f -= 128;
-    if (!f_flags.f_subtract) new_f -= 64;
-    if (!f_flags.f_half_carry) new_f -= 32;
-    if (!f_flags.f_carry) new_f -= 16;
+void cpu::hblank_dma() {
+    if (!hdma_active) return;
+
+    dma_block_copy(1);
+    dma_stall += 32u << double_speed;
+
+    hdma_blocks--;
+    if (hdma_blocks == 0) {
+        hdma_active = false;
+        mram[0xFF55] = 0xFF;
+    } else {
+        mram[0xFF55] = static_cast<unsigned char>(hdma_blocks - 1);
+    }
+}
 
-    registers.f = new_f;
+// BCPS/OCPS hold a byte index (bits 0-5) and auto-increment (bit 7); BCPD/OCPD read and write
+// the palette byte at that index. The data registers are kept current in mram for reads.
+void cpu::palette_write(unsigned short addr, unsigned char value) {
+    unsigned char* pal = addr < 0xFF6A ? bg_palette : obj_palette;
+    unsigned short spec = addr < 0xFF6A ? 0xFF68 : 0xFF6A;
+
+    if (addr == spec) {
+        mram[spec] = value | 0x40;
+    } else {
+        unsigned char index = mram[spec] & 0x3F;
+        pal[index] = value;
+        if (mram[spec] & 0x80) mram[spec] = 0xC0 | ((index + 1) & 0x3F);
+    }
+    mram[spec + 1] = pal[mram[spec] & 0x3F];
 }
\ No newline at end of file
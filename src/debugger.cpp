@@ -0,0 +1,90 @@
+#include <cstdio>
+#include <cstring>
+
+#include <cpu.h>
+#include <debugger.h>
+#include <disasm.h>
+
+using std::string;
+
+debugger::debugger(cpu* c) {
+    this->c = c;
+    memset(exec_map, 0, sizeof(exec_map));
+    memset(watched_pages, 0, sizeof(watched_pages));
+}
+
+void debugger::add_breakpoint(unsigned short addr) {
+    exec_map[addr >> 6] |= 1ull << (addr & 63);
+}
+
+void debugger::remove_breakpoint(unsigned short addr) {
+    exec_map[addr >> 6] &= ~(1ull << (addr & 63));
+}
+
+void debugger::add_watchpoint(unsigned short addr, unsigned int length, unsigned int kind) {
+    if (length == 0) length = 1;
+    if (length > 0x10000u - addr) length = 0x10000u - addr;
+
+    watches.push_back({ addr, length, kind });
+    update_pages();
+}
+
+void debugger::remove_watchpoint(unsigned short addr, unsigned int length, unsigned int kind) {
+    if (length == 0) length = 1;
+    if (length > 0x10000u - addr) length = 0x10000u - addr;
+
+    for (size_t i = 0; i < watches.size(); i++) {
+        if (watches[i].addr == addr && watches[i].length == length && watches[i].kind == kind) {
+            watches.erase(watches.begin() + i);
+            break;
+        }
+    }
+    update_pages();
+}
+
+void debugger::update_pages() {
+    memset(watched_pages, 0, sizeof(watched_pages));
+    for (const watch& w : watches) {
+        unsigned int last = w.addr + w.length - 1;
+        for (unsigned int page = w.addr >> 8; page <= last >> 8; page++) watched_pages[page] |= w.kind;
+    }
+
+    c->update_access_checks();
+}
+
+void debugger::check_access(unsigned short addr, unsigned int kind) {
+    if (stopped != none) return;
+
+    for (const watch& w : watches) {
+        if ((w.kind & kind) && addr >= w.addr && static_cast<unsigned int>(addr - w.addr) < w.length) {
+            stopped = kind == writes ? watch_write : watch_read;
+            stop_addr = addr;
+            stop_pc = c->prog_counter_copy;
+            return;
+        }
+    }
+}
+
+void debugger::halt() {
+    if (stopped != none) return;
+    stopped = interrupt;
+    stop_addr = c->prog_counter;
+    stop_pc = c->prog_counter;
+}
+
+void debugger::resume() {
+    stopped = none;
+}
+
+string debugger::describe() const {
+    static const char* reasons[] = { "Running", "Breakpoint", "Step", "Read watchpoint", "Write watchpoint", "Interrupted" };
+
+    unsigned char bytes[3] = { c->mram[stop_pc], c->mram[(stop_pc + 1) & 0xFFFF], c->mram[(stop_pc + 2) & 0xFFFF] };
+    char buf[160];
+    snprintf(buf, sizeof(buf), "%s at $%04X: $%04X %-14s AF=%02X%02X BC=%02X%02X DE=%02X%02X HL=%02X%02X SP=%04X",
+        reasons[stopped], stop_addr, stop_pc, disassemble(stop_pc, bytes).c_str(),
+        c->registers.a, c->registers.f, c->registers.b, c->registers.c,
+        c->registers.d, c->registers.e, c->registers.h, c->registers.l, c->stack_pointer);
+
+    return buf;
+}
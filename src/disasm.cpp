@@ -0,0 +1,54 @@
+#include <cstdio>
+#include <cstring>
+
+#include <disasm.h>
+#include <opcodes.h>
+
+using std::string;
+
+unsigned int instruction_length(const unsigned char* bytes) {
+    return opcode_lookup(bytes[0], bytes[1]).length;
+}
+
+string disassemble(unsigned short pc, const unsigned char* bytes) {
+    const opcode_info& op = opcode_lookup(bytes[0], bytes[1]);
+    if (op.operand == operand_none) return op.mnemonic;
+
+    // The placeholder named after the operand kind is replaced with its value.
+    const char* names[] = { "", "d8", "d16", "a8", "a16", "s8" };
+    const char* name = names[op.operand];
+    const char* at = strstr(op.mnemonic, name);
+
+    string out(op.mnemonic, at);
+    char buf[16];
+
+    switch (op.operand) {
+        case operand_d16:
+        case operand_a16:
+            snprintf(buf, sizeof(buf), "$%04X", bytes[1] | (bytes[2] << 8));
+            break;
+        case operand_d8:
+            snprintf(buf, sizeof(buf), "$%02X", bytes[1]);
+            break;
+        case operand_a8:
+            snprintf(buf, sizeof(buf), "$FF%02X", bytes[1]);
+            break;
+        default: {
+            signed char s8 = static_cast<signed char>(bytes[1]);
+
+            // JR targets are relative to the following instruction; ADD SP and LD HL, SP+
+            // just show the signed offset.
+            if (op.ends_block) {
+                snprintf(buf, sizeof(buf), "$%04X", static_cast<unsigned short>(pc + op.length + s8));
+            } else {
+                if (!out.empty() && out.back() == '+') out.pop_back();
+                snprintf(buf, sizeof(buf), "%+d", s8);
+            }
+            break;
+        }
+    }
+
+    out += buf;
+    out += at + strlen(name);
+    return out;
+}
@@ -0,0 +1,417 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include <cpu.h>
+#include <debugger.h>
+#include <gdb_stub.h>
+
+using std::cout;
+using std::endl;
+using std::string;
+
+static const char* target_xml =
+    "<?xml version=\"1.0\"?>"
+    "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+    "<target version=\"1.0\">"
+    "<feature name=\"org.gameboy.sm83\">"
+    "<reg name=\"af\" bitsize=\"16\" type=\"uint16\"/>"
+    "<reg name=\"bc\" bitsize=\"16\" type=\"uint16\"/>"
+    "<reg name=\"de\" bitsize=\"16\" type=\"uint16\"/>"
+    "<reg name=\"hl\" bitsize=\"16\" type=\"uint16\"/>"
+    "<reg name=\"sp\" bitsize=\"16\" type=\"data_ptr\"/>"
+    "<reg name=\"pc\" bitsize=\"16\" type=\"code_ptr\"/>"
+    "</feature>"
+    "</target>";
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static int hex_value(char ch) {
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    return -1;
+}
+
+// Registers go over the wire in target byte order, which is little-endian.
+static void append_word(string& out, unsigned int value) {
+    out += hex_digits[(value >> 4) & 0xF];
+    out += hex_digits[value & 0xF];
+    out += hex_digits[(value >> 12) & 0xF];
+    out += hex_digits[(value >> 8) & 0xF];
+}
+
+static bool all_hex(const char* p, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (hex_value(p[i]) < 0) return false;
+    }
+    return true;
+}
+
+static bool parse_word(const char* hex, unsigned int& value) {
+    if (!all_hex(hex, 4)) return false;
+    value = hex_value(hex[0]) << 4 | hex_value(hex[1]) | hex_value(hex[2]) << 12 | hex_value(hex[3]) << 8;
+    return true;
+}
+
+// Reads one field of an argument list such as "addr,length": a hex number of at least one digit,
+// then sep, or the end of the packet when sep is 0. p is left after the separator.
+static bool parse_field(const char*& p, unsigned long& value, char sep) {
+    if (hex_value(*p) < 0) return false;
+
+    value = 0;
+    for (; hex_value(*p) >= 0; p++) value = (value << 4 | hex_value(*p)) & 0xFFFFFFFF;
+
+    if (*p != sep) return false;
+    if (sep != 0) p++;
+    return true;
+}
+
+gdb_stub::gdb_stub(cpu* c, debugger* debug) {
+    this->c = c;
+    this->debug = debug;
+}
+
+gdb_stub::~gdb_stub() {
+    net_close(client);
+    net_close(listener);
+}
+
+bool gdb_stub::listen(const char* address) {
+    listener = net_listen(address);
+    if (listener == net_invalid) return false;
+
+    cout << "Waiting for GDB on " << address << endl;
+    return true;
+}
+
+void gdb_stub::drop_client() {
+    net_close(client);
+    client = net_invalid;
+    acks = true;
+    input.clear();
+}
+
+void gdb_stub::poll() {
+    if (client == net_invalid) {
+        if (listener == net_invalid) return;
+        client = net_accept(listener, false);
+        if (client == net_invalid) return;
+
+        // The client asks why the target stopped with '?' once it has set itself up.
+        cout << "GDB attached" << endl;
+        debug->halt();
+        answer();
+        return;
+    }
+
+    char buf[256];
+    int got = net_recv(client, buf, sizeof(buf), false);
+    if (got < 0) {
+        cout << "GDB detached" << endl;
+        drop_client();
+        return;
+    }
+
+    input.append(buf, got);
+    if (input.find('\x03') != string::npos) {
+        input.erase(0, input.find('\x03') + 1);
+        debug->halt();
+        serve();
+    }
+}
+
+// Takes the next "$data#checksum" packet out of input, reading from the client as needed and
+// acknowledging it. Stray acks and interrupts between packets are skipped.
+bool gdb_stub::read_packet(string& packet) {
+    while (true) {
+        size_t start = input.find('$');
+        size_t end = start == string::npos ? string::npos : input.find('#', start);
+
+        if (end != string::npos && end + 2 < input.size()) {
+            packet = input.substr(start + 1, end - start - 1);
+            unsigned int sum = 0;
+            for (unsigned char ch : packet) sum += ch;
+
+            bool good = all_hex(&input[end + 1], 2) &&
+                (sum & 0xFF) == static_cast<unsigned int>(hex_value(input[end + 1]) << 4 | hex_value(input[end + 2]));
+            input.erase(0, end + 3);
+
+            if (acks) {
+                net_send(client, good ? "+" : "-", 1);
+                if (!good) continue;
+            }
+            return true;
+        }
+
+        char buf[4096];
+        int got = net_recv(client, buf, sizeof(buf), true);
+        if (got < 0) return false;
+        input.append(buf, got);
+    }
+}
+
+void gdb_stub::send_packet(const string& data) {
+    unsigned int sum = 0;
+    for (unsigned char ch : data) sum += ch;
+
+    string out = "$" + data + "#";
+    out += hex_digits[(sum >> 4) & 0xF];
+    out += hex_digits[sum & 0xF];
+    net_send(client, out.data(), out.size());
+}
+
+string gdb_stub::stop_reply() const {
+    char buf[32];
+    switch (debug->stopped) {
+        case debugger::watch_write:
+            snprintf(buf, sizeof(buf), "T05watch:%04x;", debug->stop_addr);
+            return buf;
+        case debugger::watch_read:
+            snprintf(buf, sizeof(buf), "T05rwatch:%04x;", debug->stop_addr);
+            return buf;
+        case debugger::interrupt:
+            return "S02";
+        default:
+            return "S05";
+    }
+}
+
+void gdb_stub::serve() {
+    if (client == net_invalid) return;
+
+    send_packet(stop_reply());
+    answer();
+}
+
+void gdb_stub::answer() {
+    string packet;
+    while (true) {
+        if (!read_packet(packet)) {
+            cout << "GDB detached" << endl;
+            drop_client();
+            debug->resume();
+            return;
+        }
+        if (!handle(packet)) return;
+    }
+}
+
+string gdb_stub::read_registers() const {
+    string out;
+    append_word(out, c->get_af());
+    append_word(out, c->get_bc());
+    append_word(out, c->get_de());
+    append_word(out, c->get_hl());
+    append_word(out, c->stack_pointer);
+    append_word(out, c->prog_counter);
+    return out;
+}
+
+void gdb_stub::write_register(unsigned int index, unsigned int value) {
+    switch (index) {
+        case 0: c->set_af(value); break;
+        case 1: c->set_bc(value); break;
+        case 2: c->set_de(value); break;
+        case 3: c->set_hl(value); break;
+        case 4: c->stack_pointer = value; break;
+        case 5: c->prog_counter = value; break;
+    }
+}
+
+// Reads are straight out of the address space: no watchpoints fire and no DMA conflict is
+// modelled, and a whole dump is one pass over mram.
+string gdb_stub::read_memory(unsigned int addr, unsigned int length) const {
+    string out;
+    out.reserve(length * 2);
+    for (unsigned int i = 0; i < length; i++) {
+        unsigned char byte = c->mram[(addr + i) & 0xFFFF];
+        out += hex_digits[byte >> 4];
+        out += hex_digits[byte & 0xF];
+    }
+    return out;
+}
+
+// Writes to IO registers go through io_write so the devices see them; the rest is plain
+// memory, as for the CPU. hex has already been checked.
+void gdb_stub::write_memory(unsigned int addr, const string& hex) {
+    for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+        unsigned short a = static_cast<unsigned short>(addr + i / 2);
+        unsigned char value = static_cast<unsigned char>(hex_value(hex[i]) << 4 | hex_value(hex[i + 1]));
+        if (cpu::is_io(a)) c->io_write(a, value);
+        else c->mram[a] = value;
+    }
+}
+
+// Z/z type,addr,kind: 0 and 1 are breakpoints, 2 write, 3 read and 4 access watchpoints.
+bool gdb_stub::change_point(bool insert, unsigned long type, unsigned long addr, unsigned long length) {
+    if (type <= 1) {
+        if (insert) debug->add_breakpoint(static_cast<unsigned short>(addr));
+        else debug->remove_breakpoint(static_cast<unsigned short>(addr));
+        return true;
+    }
+    if (type > 4) return false;
+
+    unsigned int kind = type == 2 ? debugger::writes : type == 3 ? debugger::reads : debugger::reads | debugger::writes;
+    if (insert) debug->add_watchpoint(static_cast<unsigned short>(addr), static_cast<unsigned int>(length), kind);
+    else debug->remove_watchpoint(static_cast<unsigned short>(addr), static_cast<unsigned int>(length), kind);
+    return true;
+}
+
+// Malformed arguments get E01.
+bool gdb_stub::handle(const string& packet) {
+    char kind = packet.empty() ? 0 : packet[0];
+    string args = packet.size() > 1 ? packet.substr(1) : "";
+    const char* p = args.c_str();
+
+    switch (kind) {
+        case '?':
+            send_packet(stop_reply());
+            return true;
+
+        case 'g':
+            send_packet(read_registers());
+            return true;
+
+        case 'G': {
+            if (args.size() % 4 != 0 || !all_hex(p, args.size())) {
+                send_packet("E01");
+                return true;
+            }
+            unsigned int value;
+            for (unsigned int i = 0; i < 6 && (i + 1) * 4 <= args.size(); i++) {
+                parse_word(&args[i * 4], value);
+                write_register(i, value);
+            }
+            send_packet("OK");
+            return true;
+        }
+
+        case 'p': {
+            unsigned long index;
+            if (!parse_field(p, index, 0) || index > 5) {
+                send_packet("E01");
+                return true;
+            }
+            string all = read_registers();
+            send_packet(all.substr(index * 4, 4));
+            return true;
+        }
+
+        case 'P': {
+            unsigned long index;
+            unsigned int value;
+            if (!parse_field(p, index, '=') || index > 5 || strlen(p) != 4 || !parse_word(p, value)) {
+                send_packet("E01");
+                return true;
+            }
+            write_register(static_cast<unsigned int>(index), value);
+            send_packet("OK");
+            return true;
+        }
+
+        case 'm': {
+            unsigned long addr, length;
+            if (!parse_field(p, addr, ',') || !parse_field(p, length, 0)) {
+                send_packet("E01");
+                return true;
+            }
+            if (length > 0x10000) length = 0x10000;
+            send_packet(read_memory(static_cast<unsigned int>(addr), static_cast<unsigned int>(length)));
+            return true;
+        }
+
+        case 'M': {
+            unsigned long addr, length;
+            if (!parse_field(p, addr, ',') || !parse_field(p, length, ':') || strlen(p) != length * 2 ||
+                !all_hex(p, length * 2)) {
+                send_packet("E01");
+                return true;
+            }
+            write_memory(static_cast<unsigned int>(addr), p);
+            send_packet("OK");
+            return true;
+        }
+
+        // A condition list after the kind (";X...") isn't supported and is refused.
+        case 'Z': case 'z': {
+            unsigned long type, addr, length;
+            if (!parse_field(p, type, ',') || !parse_field(p, addr, ',') || !parse_field(p, length, 0)) {
+                send_packet("E01");
+                return true;
+            }
+            send_packet(change_point(kind == 'Z', type, addr, length) ? "OK" : "");
+            return true;
+        }
+
+        // Continue or step, optionally from a new address.
+        case 'c': case 's': {
+            unsigned long addr;
+            if (!args.empty()) {
+                if (!parse_field(p, addr, 0)) {
+                    send_packet("E01");
+                    return true;
+                }
+                c->prog_counter = static_cast<unsigned short>(addr);
+            }
+            debug->resume();
+            debug->single_step = kind == 's';
+            if (!args.empty()) debug->arrive(c->prog_counter);
+            return false;
+        }
+
+        case 'D':
+            send_packet("OK");
+            cout << "GDB detached" << endl;
+            drop_client();
+            debug->resume();
+            return false;
+
+        case 'k':
+            drop_client();
+            debug->resume();
+            return false;
+
+        case 'H':
+            send_packet("OK");
+            return true;
+
+        case 'q':
+            if (packet.compare(0, 10, "qSupported") == 0) {
+                send_packet("PacketSize=4000;qXfer:features:read+;QStartNoAckMode+");
+            } else if (packet == "qAttached") {
+                send_packet("1");
+            } else if (packet == "qC") {
+                send_packet("QC1");
+            } else if (packet == "qfThreadInfo") {
+                send_packet("m1");
+            } else if (packet == "qsThreadInfo") {
+                send_packet("l");
+            } else if (packet.compare(0, 31, "qXfer:features:read:target.xml:") == 0) {
+                // qXfer:features:read:target.xml:offset,length
+                const char* q = packet.c_str() + 31;
+                unsigned long offset, length;
+                string xml = target_xml;
+                if (!parse_field(q, offset, ',') || !parse_field(q, length, 0)) send_packet("E01");
+                else if (offset >= xml.size()) send_packet("l");
+                else if (offset + length >= xml.size()) send_packet("l" + xml.substr(offset));
+                else send_packet("m" + xml.substr(offset, length));
+            } else {
+                send_packet("");
+            }
+            return true;
+
+        case 'Q':
+            if (packet == "QStartNoAckMode") {
+                send_packet("OK");
+                acks = false;
+            } else {
+                send_packet("");
+            }
+            return true;
+
+        default:
+            send_packet("");
+            return true;
+    }
+}
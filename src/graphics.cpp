@@ -1,12 +1,19 @@
+#include <cstring>
 #include <iostream>
 
 #include <graphics.h>
+#include <scaler.h>
+#include <triple_buffer.h>
 #include <SDL2/SDL.h>
 
 using std::cout;
 using std::endl;
 
 graphics::graphics(unsigned int width, unsigned int height, unsigned int size_modifier, const char* title) {
+    this->width = width;
+    this->height = height;
+    this->size_modifier = size_modifier;
+
     SDL_Init(SDL_INIT_EVERYTHING);
 
     window = SDL_CreateWindow(
@@ -19,23 +26,136 @@ graphics::graphics(unsigned int width, unsigned int height, unsigned int size_mo
     if (window == NULL) {
         cout << "Couldn't create SDL window" << endl;
     }
+}
+
+graphics::~graphics() {
+    end_graphics();
+}
+
+void graphics::set_size_modifier(unsigned int size_modifier) {
+    this->size_modifier = size_modifier;
+    if (window != NULL) SDL_SetWindowSize(window, width * size_modifier, height * size_modifier);
+}
 
-    renderer = SDL_CreateRenderer(window, -1, 0);
+void graphics::start_presenting(triple_buffer* frames) {
+    this->frames = frames;
+    presenter = std::thread(&graphics::present_loop, this);
+}
+
+void graphics::frame_published() {
+    // The lock only guards the wakeup; the present thread never holds it across SDL calls.
+    std::lock_guard<std::mutex> guard(wake_lock);
+    wake.notify_one();
+}
+
+bool graphics::create_renderer(Uint32 flags) {
+    renderer = SDL_CreateRenderer(window, -1, flags);
+    if (renderer == NULL) {
+        cout << "Error: problem creating SDL renderer: " << SDL_GetError() << endl;
+        return false;
+    }
 	SDL_RenderSetLogicalSize(renderer, width * size_modifier, height * size_modifier);
 
     texture = SDL_CreateTexture(
         renderer, 
         SDL_PIXELFORMAT_ARGB8888, 
         SDL_TEXTUREACCESS_STREAMING, 
-        width, height
+        width * factor(), height * factor()
     );
+    return texture != NULL;
 }
 
-void graphics::update_graphics() {
-    SDL_UpdateTexture(texture, nullptr, {}, 64 * sizeof(unsigned int));
+void graphics::present_loop() {
+    if (!create_renderer(SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC)) return;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(wake_lock);
+            wake.wait(guard, [this]() { return stopping || frames->has_new(); });
+            if (stopping) break;
+        }
+
+        update_graphics(frames->acquire());
+    }
+
+    SDL_DestroyTexture(texture);
+    SDL_DestroyRenderer(renderer);
+    texture = nullptr;
+    renderer = nullptr;
+}
+
+bool graphics::start_direct() {
+    return create_renderer(0);
+}
+
+unsigned int* graphics::lock_frame(unsigned int& pitch) {
+    if (locked != nullptr) {
+        pitch = locked_pitch;
+        return locked;
+    }
+    if (!lockable || scale != nullptr) return nullptr;
+
+    void* pixels;
+    int bytes;
+    if (SDL_LockTexture(texture, nullptr, &pixels, &bytes) != 0) {
+        lockable = false;
+        return nullptr;
+    }
+
+    locked = static_cast<unsigned int*>(pixels);
+    locked_pitch = static_cast<unsigned int>(bytes) / sizeof(unsigned int);
+    pitch = locked_pitch;
+    return locked;
+}
+
+void graphics::present_locked() {
+    SDL_UnlockTexture(texture);
+    locked = nullptr;
+    texture_uploads++;
+    present();
+}
+
+unsigned int graphics::factor() const {
+    return scale != nullptr ? scale->factor : 1;
+}
+
+// Uploads a frame with a pitch of width pixels, through the scaler if there is one. Locking
+// lets the rows (or the scaler's output) go straight into the texture's memory; renderers
+// that can't lock get SDL_UpdateTexture.
+void graphics::update_graphics(const unsigned int* pixels) {
+    unsigned int w = width * factor();
+    unsigned int h = height * factor();
+
+    void* dst;
+    int bytes;
+    if (lockable && SDL_LockTexture(texture, nullptr, &dst, &bytes) == 0) {
+        if (scale != nullptr) {
+            scale->run(pixels, width, width, height, static_cast<unsigned int*>(dst), bytes / sizeof(unsigned int));
+        } else {
+            unsigned char* row = static_cast<unsigned char*>(dst);
+            for (unsigned int y = 0; y < height; y++) {
+                memcpy(row + y * bytes, pixels + y * width, width * sizeof(unsigned int));
+            }
+        }
+        SDL_UnlockTexture(texture);
+    } else {
+        lockable = false;
+        if (scale != nullptr) {
+            scaled.resize(w * h);
+            scale->run(pixels, width, width, height, scaled.data(), w);
+            pixels = scaled.data();
+        }
+        SDL_UpdateTexture(texture, nullptr, pixels, w * sizeof(unsigned int));
+    }
+    texture_uploads++;
+    present();
+}
+
+void graphics::present() {
 	SDL_RenderClear(renderer);
 	SDL_RenderCopy(renderer, texture, nullptr, nullptr);
 	SDL_RenderPresent(renderer);
+    frames_presented++;
 }
 
 bool graphics::fetch_input() {
@@ -64,6 +184,23 @@ bool graphics::fetch_input() {
 }
 
 void graphics::end_graphics() {
+    if (window == nullptr) return;
+
+    if (locked != nullptr) {
+        SDL_UnlockTexture(texture);
+        locked = nullptr;
+    }
+
+    if (presenter.joinable()) {
+        {
+            std::lock_guard<std::mutex> guard(wake_lock);
+            stopping = true;
+        }
+        wake.notify_one();
+        presenter.join();
+    }
+
     SDL_DestroyWindow(window);
+    window = nullptr;
     SDL_Quit();
 }
\ No newline at end of file
@@ -1,23 +1,424 @@
+#include <atomic>
+#include <cstdlib>
 #include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
 #include <SDL2/SDL.h>
 
+#include <apu.h>
+#include <audio.h>
+#include <audio_ring.h>
+#include <capture.h>
+#include <cheats.h>
 #include <cpu.h>
+#include <debugger.h>
+#include <gdb_stub.h>
 #include <graphics.h>
+#include <perf.h>
+#include <ppu.h>
+#include <profiler.h>
+#include <scaler.h>
+#include <serial.h>
+#include <trace.h>
+#include <triple_buffer.h>
 
 using std::cout;
 using std::endl;
+using std::string;
+using std::vector;
 
 int main(int argc, char *argv[]) {
+    const char* rom = "C:/Users/ianga/Desktop/Codespaces/gb/roms/pokemon_red.gb";
+    const char* profile_prefix = nullptr;
+    const char* trace_path = nullptr;
+    const char* exec_trace_path = nullptr;
+    unsigned int exec_trace_records = 1 << 20;
+    bool show_stats = false;
+    bool render = true;
+    bool sound = true;
+    bool pacing = true;
+    bool direct = false;
+    const char* scale_name = nullptr;
+    unsigned int audio_latency_ms = 0;
+    unsigned int render_every = 1;
+    unsigned int run_ahead = 0;
+    const char* link_listen = nullptr;
+    const char* link_connect = nullptr;
+    const char* link_rom = nullptr;
+    vector<string> breakpoints;
+    vector<string> write_watches;
+    vector<string> read_watches;
+    const char* gdb_address = nullptr;
+    vector<string> cheat_codes;
+    const char* cheat_file = nullptr;
+    const char* boot_rom = nullptr;
+    const char* capture_target = nullptr;
+    unsigned int capture_buffers = 16;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--profile" && i + 1 < argc) profile_prefix = argv[++i];
+        else if (arg == "--trace" && i + 1 < argc) trace_path = argv[++i];
+        else if (arg == "--stats") show_stats = true;
+        else if (arg == "--no-render") render = false;
+        else if (arg == "--no-audio") sound = false;
+        else if (arg == "--no-pacing") pacing = false;
+        else if (arg == "--direct-present") direct = true;
+        else if (arg == "--scale" && i + 1 < argc) scale_name = argv[++i];
+        else if (arg == "--audio-latency" && i + 1 < argc) audio_latency_ms = atoi(argv[++i]);
+        else if (arg == "--render-every" && i + 1 < argc) render_every = atoi(argv[++i]);
+        else if (arg == "--run-ahead" && i + 1 < argc) run_ahead = atoi(argv[++i]);
+        else if (arg == "--link-listen" && i + 1 < argc) link_listen = argv[++i];
+        else if (arg == "--link-connect" && i + 1 < argc) link_connect = argv[++i];
+        else if (arg == "--link-local" && i + 1 < argc) link_rom = argv[++i];
+        else if (arg == "--break" && i + 1 < argc) breakpoints.push_back(argv[++i]);
+        else if (arg == "--watch" && i + 1 < argc) write_watches.push_back(argv[++i]);
+        else if (arg == "--watch-read" && i + 1 < argc) read_watches.push_back(argv[++i]);
+        else if (arg == "--gdb" && i + 1 < argc) gdb_address = argv[++i];
+        else if (arg == "--cheat" && i + 1 < argc) cheat_codes.push_back(argv[++i]);
+        else if (arg == "--cheat-file" && i + 1 < argc) cheat_file = argv[++i];
+        else if (arg == "--boot-rom" && i + 1 < argc) boot_rom = argv[++i];
+        else if (arg == "--capture" && i + 1 < argc) capture_target = argv[++i];
+        else if (arg == "--capture-buffers" && i + 1 < argc) capture_buffers = atoi(argv[++i]);
+        else if (arg == "--exec-trace" && i + 1 < argc) exec_trace_path = argv[++i];
+        else if (arg == "--exec-trace-records" && i + 1 < argc) exec_trace_records = atoi(argv[++i]);
+        else rom = argv[i];
+    }
+
     graphics* gfx = new graphics(160, 144, 3, "gameboy");
     cpu* c = new cpu();
+    ppu* gpu = new ppu(c);
+
+    // --boot-rom <file> runs the boot ROM first; without it the game starts at 0x0100.
+    if (boot_rom != nullptr && !c->load_boot_rom(boot_rom)) return -1;
 
-    bool loaded = c->load_rom("C:/Users/ianga/Desktop/Codespaces/gb/roms/pokemon_red.gb");
+    bool loaded = c->load_rom(rom);
     if (!loaded) return -1;
 
+    // --profile <prefix> writes <prefix>.folded (collapsed stacks) and <prefix>.txt (hot blocks) on exit.
+    if (profile_prefix != nullptr) c->prof = new profiler(c->rom_banks);
+
+    // --exec-trace <file> keeps the last --exec-trace-records instructions in a binary ring; decode it with trace_decode.
+    trace_buffer* exec_trace = nullptr;
+    if (exec_trace_path != nullptr) {
+        exec_trace = new trace_buffer();
+        if (exec_trace->open(exec_trace_path, exec_trace_records)) c->tracer = exec_trace;
+    }
+
+    // --trace <file> writes Chrome trace spans per frame; --stats prints a counters line every second.
+    perf* stats = new perf();
+    if (trace_path != nullptr) stats->open_trace(trace_path);
+    if (show_stats) stats->stats_interval_ms = 1000;
+
+    // --no-render and --render-every N skip pixel composition (and the texture upload) for
+    // skipped frames while LY, STAT and interrupts still run exactly.
+    gpu->render_enabled = render;
+    gpu->render_every = render_every;
+
+    // The PPU draws into the back buffer of a triple buffer; finished frames are published
+    // to the present thread, which uploads and presents them on its own schedule.
+    // --direct-present instead renders on this thread, with the PPU writing straight into the
+    // locked streaming texture (no per-frame copy) and presenting without vsync.
+    // --scale nearest|scale2x|scale3x|xbr upscales on the CPU before upload, for renderers
+    // without GPU acceleration where SDL's own stretch is a slow software blit. The window
+    // takes the scaler's factor, a multiple of 2 or 3 for the filters, so SDL copies 1:1.
+    if (scale_name != nullptr) {
+        scaler::filter filter;
+        if (scaler::parse(scale_name, filter)) {
+            gfx->scale = new scaler(filter, gfx->size_modifier);
+            if (filter != scaler::none) gfx->set_size_modifier(gfx->scale->factor);
+        } else {
+            cout << "Error: unknown scaler " << scale_name << endl;
+        }
+    }
+
+    // --capture <file.y4m|file.rgb|dir/name.png|"|command"> records every displayed frame on a
+    // background thread; frames are dropped, not waited for, when all --capture-buffers are full.
+    frame_capture* capture = nullptr;
+    if (capture_target != nullptr) {
+        capture = new frame_capture();
+        if (!capture->start(capture_target, capture_buffers)) {
+            delete capture;
+            capture = nullptr;
+        }
+    }
+
+    triple_buffer* frames = nullptr;
+    if (direct) direct = gfx->start_direct();
+    if (!direct) {
+        frames = new triple_buffer();
+        gpu->framebuffer = frames->back();
+        gfx->start_presenting(frames);
+    }
+
+    // Sound is mixed at 48 kHz into a ring of about 170 ms that the SDL callback drains.
+    // --no-audio leaves the APU registers as plain memory.
+    const unsigned int sample_rate = 48000;
+    audio_ring* ring = nullptr;
+    apu* sound_unit = nullptr;
+    audio* speaker = nullptr;
+    if (sound) {
+        ring = new audio_ring(16384);
+        sound_unit = new apu(c, sample_rate);
+        sound_unit->out = ring;
+        c->sound = sound_unit;
+
+        speaker = new audio(ring, sample_rate, 256);
+        if (audio_latency_ms != 0) speaker->target_frames = sample_rate * audio_latency_ms / 1000;
+        if (!speaker->open()) {
+            delete speaker;
+            speaker = nullptr;
+        }
+    }
+
+    // Link cable. --link-listen / --link-connect <socket path> cable two processes together;
+    // --link-local <rom> runs a second, headless instance on another thread, stepped in
+    // lock-step with this one a frame at a time. Either way the two sides only exchange
+    // messages when a byte is transferred. Run-ahead can't un-send a byte, so it is turned off.
+    serial* port = nullptr;
+    std::unique_ptr<link_transport> cable;
+    std::unique_ptr<local_link> peer_cable;
+    if (link_listen != nullptr || link_connect != nullptr) {
+        socket_link* s = new socket_link();
+        cable.reset(s);
+        if (link_listen != nullptr ? s->listen(link_listen) : s->connect(link_connect)) port = new serial(c);
+    } else if (link_rom != nullptr) {
+        std::unique_ptr<local_link> here;
+        local_link::make_pair(here, peer_cable);
+        cable.reset(here.release());
+        port = new serial(c);
+    }
+    if (port != nullptr) {
+        port->link = cable.get();
+        c->port = port;
+        run_ahead = 0;
+    }
+
+    // --break <addr> stops before the instruction at addr; --watch / --watch-read <addr>[+len]
+    // stop after an instruction writes / reads that memory. Addresses are hex. Each stop is
+    // logged with the instruction and registers and execution carries on, unless a GDB client
+    // is attached through --gdb tcp:<port> or --gdb <socket path>, in which case it takes over.
+    // Run-ahead would replay frames and report every stop twice, so it is turned off.
+    debugger* debug = nullptr;
+    gdb_stub* gdb = nullptr;
+    if (!breakpoints.empty() || !write_watches.empty() || !read_watches.empty() || gdb_address != nullptr) {
+        debug = new debugger(c);
+        c->debug = debug;
+        run_ahead = 0;
+
+        auto add_watches = [&](const vector<string>& specs, unsigned int kind) {
+            for (const string& spec : specs) {
+                size_t plus = spec.find('+');
+                unsigned long addr = strtoul(spec.c_str(), nullptr, 16);
+                unsigned long length = plus == string::npos ? 1 : strtoul(spec.c_str() + plus + 1, nullptr, 0);
+                debug->add_watchpoint(static_cast<unsigned short>(addr), static_cast<unsigned int>(length), kind);
+            }
+        };
+
+        for (const string& spec : breakpoints) debug->add_breakpoint(static_cast<unsigned short>(strtoul(spec.c_str(), nullptr, 16)));
+        add_watches(write_watches, debugger::writes);
+        add_watches(read_watches, debugger::reads);
+        debug->arrive(c->prog_counter);
+
+        if (gdb_address != nullptr) {
+            gdb = new gdb_stub(c, debug);
+            if (!gdb->listen(gdb_address)) {
+                delete gdb;
+                gdb = nullptr;
+            }
+        }
+    }
+
+    std::atomic<unsigned long long> frames_run(0);
+    std::atomic<bool> peer_stop(false);
+    std::thread peer;
+    if (peer_cable) {
+        peer = std::thread([&]() {
+            cpu* pc = new cpu();
+            ppu* pgpu = new ppu(pc);
+            serial* pport = new serial(pc);
+            pport->link = peer_cable.get();
+            pc->port = pport;
+            pgpu->render_enabled = false;
+
+            if (pc->load_rom(link_rom)) {
+                for (unsigned long long frame = 0; !peer_stop && pc->running; frame++) {
+                    // Sleeps between checks, but wakes at once for a transfer from the main
+                    // instance, which is blocked until it is answered.
+                    while (frame >= frames_run && !peer_stop) {
+                        pport->poll();
+                        peer_cable->wait_for_message(1);
+                    }
+
+                    unsigned long long frame_end = pc->cycles + 70224;
+                    pgpu->frame_ready = false;
+                    while (pc->running && !pgpu->frame_ready && pc->cycles < frame_end) {
+                        pc->read();
+                        pgpu->step(pc->step_clocks);
+                        pport->step();
+                    }
+                }
+            }
+
+            peer_cable.reset();
+            delete pport;
+            delete pgpu;
+            delete pc;
+        });
+    }
+
+    // Pacing: with a sound device, the loop waits whenever the ring is deeper than the target
+    // (about 11 ms, or --audio-latency ms) and the APU resamples by up to 0.5% to hold it there,
+    // so emulation follows the sound card's clock rather than the display's. Without one it
+    // sleeps to 59.73 Hz. --no-pacing runs as fast as possible.
+    const unsigned long long frame_ns = 1000000000ull * 70224 / 4194304;
+    unsigned long long next_frame_ns = perf::now_ns();
+
+    // --cheat <code> (repeatable) and --cheat-file <file> take Game Genie, GameShark and
+    // "addr=value" freeze codes. ROM patches are applied once here; RAM values are written at
+    // the start of every frame.
+    cheats* codes = nullptr;
+    if (!cheat_codes.empty() || cheat_file != nullptr) {
+        codes = new cheats(c);
+        for (const string& code : cheat_codes) codes->add(code.c_str());
+        if (cheat_file != nullptr) codes->load(cheat_file);
+    }
+
+    // A frame ends at VBlank, or after 70224 system clocks while the LCD is off. Input is polled
+    // between frames rather than between instructions.
+    const unsigned int frame_cycles = 70224;
+
+    auto run_frame = [&]() {
+        if (codes != nullptr) codes->apply_frame();
+
+        unsigned long long frame_end = c->cycles + frame_cycles;
+        gpu->frame_ready = false;
+        while (c->running && !gpu->frame_ready && c->cycles < frame_end) {
+            // Stops are handled before the next instruction runs, so one at the starting PC or
+            // at a PC the GDB client moved to is reported before that instruction executes.
+            if (debug != nullptr && debug->stopped != debugger::none) {
+                if (gdb != nullptr && gdb->attached()) {
+                    gdb->serve();
+                } else {
+                    cout << debug->describe() << endl;
+                    debug->resume();
+                }
+                continue;
+            }
+
+            c->read();
+            gpu->step(c->step_clocks);
+            if (port != nullptr) port->step();
+        }
+        frames_run++;
+    };
+
+    // --run-ahead N hides N frames of the game's own input lag. Each displayed frame, the real
+    // frame runs with sound but no picture; its state is saved, N more frames run silently
+    // (no sound, profile or trace) with only the last one composed and shown, and the state
+    // is restored.
+    cpu::state* cpu_snapshot = run_ahead > 0 ? new cpu::state() : nullptr;
+    ppu::state ppu_snapshot;
+
     bool quit = false;  
     while (!quit && c->running) {
+        unsigned long long core_start = perf::now_ns();
+
+        if (direct) {
+            unsigned int pitch;
+            unsigned int* target = gfx->lock_frame(pitch);
+            gpu->framebuffer = target != nullptr ? target : gpu->pixels;
+            gpu->pitch = target != nullptr ? pitch : 160;
+        }
+
+        bool show = false;
+        if (run_ahead == 0) {
+            run_frame();
+            if (sound_unit != nullptr) sound_unit->run_until(c->cycles);
+            show = gpu->frame_ready && gpu->frame_rendered;
+        } else {
+            gpu->render_enabled = false;
+            run_frame();
+            if (sound_unit != nullptr) sound_unit->run_until(c->cycles);
+
+            c->save_state(*cpu_snapshot);
+            gpu->save_state(ppu_snapshot);
+            profiler* prof = c->prof;
+            trace_buffer* tracer = c->tracer;
+            c->sound = nullptr;
+            c->prof = nullptr;
+            c->tracer = nullptr;
+
+            for (unsigned int i = 0; i < run_ahead && c->running; i++) {
+                gpu->render_enabled = render && i + 1 == run_ahead;
+                run_frame();
+            }
+            show = gpu->frame_ready && gpu->frame_rendered;
+
+            c->load_state(*cpu_snapshot);
+            gpu->load_state(ppu_snapshot);
+            c->sound = sound_unit;
+            c->prof = prof;
+            c->tracer = tracer;
+            gpu->render_enabled = render;
+        }
+
+        unsigned long long core_end = perf::now_ns();
+        if (show) {
+            if (capture != nullptr) capture->push(gpu->framebuffer, gpu->pitch);
+            if (!direct) {
+                frames->publish();
+                gpu->framebuffer = frames->back();
+                gfx->frame_published();
+            } else if (gpu->framebuffer == gpu->pixels) {
+                gfx->update_graphics(gpu->pixels);
+            } else {
+                gfx->present_locked();
+            }
+        }
         quit = gfx->fetch_input();
-        c->read();
+        if (gdb != nullptr) gdb->poll();
+
+        stats->end_frame(c->instructions, gfx->texture_uploads, c->io_writes, core_start, core_end, perf::now_ns());
+
+        if (pacing && speaker != nullptr) {
+            sound_unit->set_rate_adjust(speaker->pace());
+        } else if (pacing) {
+            next_frame_ns += frame_ns;
+            unsigned long long now = perf::now_ns();
+            if (next_frame_ns > now) SDL_Delay(static_cast<Uint32>((next_frame_ns - now) / 1000000));
+            else next_frame_ns = now;
+        }
+    }
+
+    // Closing this end also wakes the peer if it is waiting on a transfer from us.
+    if (port != nullptr) port->link = nullptr;
+    cable.reset();
+    if (peer.joinable()) {
+        peer_stop = true;
+        peer.join();
+    }
+
+    gfx->end_graphics();
+    delete stats;
+    delete exec_trace;
+    delete speaker;
+    delete cpu_snapshot;
+    delete gdb;
+    delete debug;
+    delete codes;
+
+    if (capture != nullptr) {
+        capture->stop();
+        cout << "captured " << capture->captured << " frames, dropped " << capture->dropped << endl;
+        delete capture;
+    }
+
+    if (c->prof != nullptr) {
+        string prefix = profile_prefix;
+        c->prof->write_collapsed((prefix + ".folded").c_str(), c);
+        c->prof->write_report((prefix + ".txt").c_str(), c, 20);
     }
 
     return 0;
@@ -0,0 +1,223 @@
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <afunix.h>
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include <net.h>
+
+using std::cout;
+using std::endl;
+using std::string;
+
+static bool net_startup() {
+#ifdef _WIN32
+    static bool started = false;
+    if (!started) {
+        WSADATA data;
+        started = WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }
+    return started;
+#else
+    return true;
+#endif
+}
+
+// A resolved address: its family and the bytes to hand to bind() or connect().
+struct net_address {
+    int family;
+    sockaddr_storage storage;
+    socklen_t length;
+};
+
+static bool resolve(const char* address, bool listening, net_address& out) {
+    string text = address;
+    memset(&out, 0, sizeof(out));
+
+    if (text.compare(0, 4, "tcp:") == 0) {
+        string host = "127.0.0.1";
+        string port = text.substr(4);
+        size_t colon = port.rfind(':');
+        if (colon != string::npos) {
+            host = port.substr(0, colon);
+            port = port.substr(colon + 1);
+        }
+
+        addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        if (listening) hints.ai_flags = AI_PASSIVE;
+
+        addrinfo* found = nullptr;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &found) != 0 || found == nullptr) return false;
+        out.family = AF_INET;
+        out.length = static_cast<socklen_t>(found->ai_addrlen);
+        memcpy(&out.storage, found->ai_addr, found->ai_addrlen);
+        freeaddrinfo(found);
+        return true;
+    }
+
+    if (text.compare(0, 5, "unix:") == 0) text = text.substr(5);
+
+    sockaddr_un* un = reinterpret_cast<sockaddr_un*>(&out.storage);
+    if (text.empty() || text.size() >= sizeof(un->sun_path)) return false;
+    un->sun_family = AF_UNIX;
+    memcpy(un->sun_path, text.c_str(), text.size());
+    out.family = AF_UNIX;
+    out.length = sizeof(sockaddr_un);
+    return true;
+}
+
+// Debugger and link traffic is small request/reply messages, so Nagle's algorithm only adds
+// latency.
+static void no_delay(net_socket s, int family) {
+    if (family != AF_INET) return;
+    int on = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&on), sizeof(on));
+}
+
+// Writing to a peer that has gone raises SIGPIPE on POSIX, which would kill the emulator
+// instead of letting net_send report the disconnect. Linux takes a flag per send(); macOS
+// and the BSDs set it once on the socket.
+#ifdef MSG_NOSIGNAL
+static const int send_flags = MSG_NOSIGNAL;
+#else
+static const int send_flags = 0;
+#endif
+
+static void no_sigpipe(net_socket s) {
+#ifdef SO_NOSIGPIPE
+    int on = 1;
+    setsockopt(s, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#else
+    (void) s;
+#endif
+}
+
+net_socket net_listen(const char* address) {
+    net_address addr;
+    if (!net_startup() || !resolve(address, true, addr)) {
+        cout << "Error: problem with socket address " << address << endl;
+        return net_invalid;
+    }
+
+    if (addr.family == AF_UNIX) {
+        const char* path = reinterpret_cast<sockaddr_un*>(&addr.storage)->sun_path;
+#ifdef _WIN32
+        DeleteFileA(path);
+#else
+        unlink(path);
+#endif
+    }
+
+    net_socket s = static_cast<net_socket>(socket(addr.family, SOCK_STREAM, 0));
+    if (s != net_invalid && addr.family == AF_INET) {
+        int on = 1;
+        setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&on), sizeof(on));
+    }
+
+    if (s == net_invalid || bind(s, reinterpret_cast<sockaddr*>(&addr.storage), addr.length) != 0 || listen(s, 1) != 0) {
+        cout << "Error: problem listening on " << address << endl;
+        net_close(s);
+        return net_invalid;
+    }
+    return s;
+}
+
+net_socket net_accept(net_socket listener, bool wait) {
+    if (!wait) {
+#ifdef _WIN32
+        fd_set ready;
+        FD_ZERO(&ready);
+        FD_SET(static_cast<SOCKET>(listener), &ready);
+        timeval none = { 0, 0 };
+        if (select(0, &ready, nullptr, nullptr, &none) <= 0) return net_invalid;
+#else
+        pollfd p = { static_cast<int>(listener), POLLIN, 0 };
+        if (poll(&p, 1, 0) <= 0) return net_invalid;
+#endif
+    }
+
+    sockaddr_storage peer;
+    socklen_t length = sizeof(peer);
+    net_socket s = static_cast<net_socket>(accept(listener, reinterpret_cast<sockaddr*>(&peer), &length));
+    if (s != net_invalid) {
+        no_delay(s, peer.ss_family);
+        no_sigpipe(s);
+    }
+    return s;
+}
+
+net_socket net_connect(const char* address) {
+    net_address addr;
+    if (!net_startup() || !resolve(address, false, addr)) {
+        cout << "Error: problem with socket address " << address << endl;
+        return net_invalid;
+    }
+
+    net_socket s = static_cast<net_socket>(socket(addr.family, SOCK_STREAM, 0));
+    if (s == net_invalid || connect(s, reinterpret_cast<sockaddr*>(&addr.storage), addr.length) != 0) {
+        cout << "Error: problem connecting to " << address << endl;
+        net_close(s);
+        return net_invalid;
+    }
+    no_delay(s, addr.family);
+    no_sigpipe(s);
+    return s;
+}
+
+bool net_send(net_socket s, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        int sent = send(s, p, static_cast<int>(size), send_flags);
+#ifndef _WIN32
+        if (sent < 0 && errno == EINTR) continue;
+#endif
+        // EPIPE and ECONNRESET both mean the peer is gone.
+        if (sent <= 0) return false;
+        p += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+int net_recv(net_socket s, void* data, size_t size, bool wait) {
+    if (!wait) {
+#ifdef _WIN32
+        u_long queued = 0;
+        if (ioctlsocket(s, FIONREAD, &queued) != 0) return -1;
+        if (queued == 0) return 0;
+#else
+        pollfd p = { static_cast<int>(s), POLLIN, 0 };
+        int ready = poll(&p, 1, 0);
+        if (ready < 0) return -1;
+        if (ready == 0) return 0;
+#endif
+    }
+
+    int got = recv(s, static_cast<char*>(data), static_cast<int>(size), 0);
+    return got > 0 ? got : -1;
+}
+
+void net_close(net_socket s) {
+    if (s == net_invalid) return;
+#ifdef _WIN32
+    closesocket(s);
+#else
+    close(static_cast<int>(s));
+#endif
+}
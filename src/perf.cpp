@@ -0,0 +1,115 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include <perf.h>
+
+using std::cout;
+using std::endl;
+using std::memory_order_relaxed;
+
+perf::perf() {
+    origin_ns = now_ns();
+    last_stats_ns = origin_ns;
+    last_stats = read();
+}
+
+perf::~perf() {
+    if (trace.is_open()) {
+        trace << "\n]\n";
+        trace.close();
+    }
+}
+
+unsigned long long perf::now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+bool perf::open_trace(const char* path) {
+    trace.open(path);
+    if (!trace.is_open()) {
+        cout << "Error: problem writing trace to " << path << endl;
+        return false;
+    }
+
+    // Microseconds with nanosecond digits; the default format turns into scientific notation
+    // after a few minutes.
+    trace << std::fixed << std::setprecision(3) << "[";
+    trace_empty = true;
+    return true;
+}
+
+// Counters only ever have one writer, so a relaxed load and store is enough and avoids the
+// locked read-modify-write a fetch_add would cost.
+static void publish_add(std::atomic<unsigned long long>& counter, unsigned long long n) {
+    counter.store(counter.load(memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+void perf::end_frame(unsigned long long instructions, unsigned long long texture_uploads, unsigned long long io_writes,
+    unsigned long long core_start, unsigned long long core_end, unsigned long long sdl_end) {
+    unsigned long long frame_instructions = instructions - totals.instructions.load(memory_order_relaxed);
+
+    totals.instructions.store(instructions, memory_order_relaxed);
+    totals.texture_uploads.store(texture_uploads, memory_order_relaxed);
+    totals.io_writes.store(io_writes, memory_order_relaxed);
+    publish_add(totals.frames, 1);
+    publish_add(totals.core_ns, core_end - core_start);
+    publish_add(totals.sdl_ns, sdl_end - core_end);
+
+    if (trace.is_open()) {
+        trace_span("frame", core_start, sdl_end, frame_instructions);
+        trace_span("core", core_start, core_end, frame_instructions);
+        trace_span("sdl", core_end, sdl_end, 0);
+    }
+
+    if (stats_interval_ms != 0 && sdl_end - last_stats_ns >= stats_interval_ms * 1000000ull) {
+        print_stats(sdl_end);
+    }
+}
+
+perf::snapshot perf::read() const {
+    snapshot s;
+    s.instructions = totals.instructions.load(memory_order_relaxed);
+    s.frames = totals.frames.load(memory_order_relaxed);
+    s.texture_uploads = totals.texture_uploads.load(memory_order_relaxed);
+    s.io_writes = totals.io_writes.load(memory_order_relaxed);
+    s.core_ns = totals.core_ns.load(memory_order_relaxed);
+    s.sdl_ns = totals.sdl_ns.load(memory_order_relaxed);
+    return s;
+}
+
+void perf::trace_span(const char* name, unsigned long long start, unsigned long long end, unsigned long long instructions) {
+    trace << (trace_empty ? "\n" : ",\n");
+    trace_empty = false;
+
+    trace << "{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":1"
+        << ",\"ts\":" << (start - origin_ns) / 1000.0
+        << ",\"dur\":" << (end - start) / 1000.0;
+    if (instructions != 0) trace << ",\"args\":{\"instructions\":" << instructions << "}";
+    trace << "}";
+}
+
+void perf::print_stats(unsigned long long now) {
+    snapshot s = read();
+    double seconds = (now - last_stats_ns) / 1e9;
+    double busy = static_cast<double>(now - last_stats_ns);
+
+    std::ios_base::fmtflags flags = cout.flags();
+    std::streamsize precision = cout.precision();
+
+    cout << std::fixed << std::setprecision(1)
+        << "[perf] " << (s.frames - last_stats.frames) / seconds << " fps  "
+        << (s.instructions - last_stats.instructions) / seconds / 1e6 << " MIPS  "
+        << "core " << 100.0 * (s.core_ns - last_stats.core_ns) / busy << "%  "
+        << "sdl " << 100.0 * (s.sdl_ns - last_stats.sdl_ns) / busy << "%  "
+        << "textures " << s.texture_uploads - last_stats.texture_uploads << "  "
+        << "io writes " << s.io_writes - last_stats.io_writes << endl;
+
+    cout.flags(flags);
+    cout.precision(precision);
+
+    last_stats_ns = now;
+    last_stats = s;
+}
\ No newline at end of file
@@ -0,0 +1,376 @@
+#include <cstring>
+
+#include <cpu.h>
+#include <ppu.h>
+
+// DMG shades for colour indices 0-3 after the palette is applied.
+static const unsigned int shades[4] = { 0xFFFFFFFF, 0xFFAAAAAA, 0xFF555555, 0xFF000000 };
+
+ppu::ppu(cpu* c) {
+    this->c = c;
+    framebuffer = pixels;
+    memset(pixels, 0xFF, sizeof(pixels));
+}
+
+// Each line takes the first 10 objects covering it in OAM order. On DMG they are then ordered
+// by X, ties keeping OAM order; on CGB OAM order alone decides priority.
+void ppu::build_object_lists(unsigned int height) {
+    const unsigned char* oam = &c->mram[0xFE00];
+
+    memcpy(built_oam, oam, sizeof(built_oam));
+    built_height = height;
+    built_cgb = c->cgb;
+    memset(line_count, 0, sizeof(line_count));
+
+    for (unsigned int i = 0; i < 40; i++) {
+        int top = oam[i * 4] - 16;
+        int first = top < 0 ? 0 : top;
+        int last = top + static_cast<int>(height);
+        if (last > 144) last = 144;
+
+        for (int y = first; y < last; y++) {
+            if (line_count[y] < 10) line_objects[y][line_count[y]++] = static_cast<unsigned char>(i);
+        }
+    }
+
+    if (built_cgb) return;
+
+    for (unsigned int y = 0; y < 144; y++) {
+        unsigned char* found = line_objects[y];
+        for (unsigned int i = 1; i < line_count[y]; i++) {
+            unsigned char obj = found[i];
+            unsigned int j = i;
+            while (j > 0 && oam[found[j - 1] * 4 + 1] > oam[obj * 4 + 1]) {
+                found[j] = found[j - 1];
+                j--;
+            }
+            found[j] = obj;
+        }
+    }
+}
+
+// The lists are rebuilt only when OAM changed since the last build, which is usually once a
+// frame after the game's DMA; comparing 160 bytes is cheaper than rescanning 40 entries.
+const unsigned char* ppu::objects_on_line(unsigned int height, unsigned int& count) {
+    if (height != built_height || c->cgb != built_cgb || memcmp(built_oam, &c->mram[0xFE00], sizeof(built_oam)) != 0) {
+        build_object_lists(height);
+    }
+
+    count = line_count[ly];
+    return line_objects[ly];
+}
+
+void ppu::save_state(state& s) const {
+    s = { mode, dots, ly, frame_ready, frame_rendered, frames, lcd_on, stat_line, rendering_frame, window_line, next_event };
+}
+
+void ppu::load_state(const state& s) {
+    mode = s.mode;
+    dots = s.dots;
+    ly = s.ly;
+    frame_ready = s.frame_ready;
+    frame_rendered = s.frame_rendered;
+    frames = s.frames;
+    lcd_on = s.lcd_on;
+    stat_line = s.stat_line;
+    rendering_frame = s.rendering_frame;
+    window_line = s.window_line;
+    next_event = s.next_event;
+}
+
+void ppu::start_frame() {
+    window_line = 0;
+    rendering_frame = render_enabled && (render_every <= 1 || frames % render_every == 0);
+}
+
+void ppu::set_mode(unsigned int m) {
+    mode = m;
+    update_stat();
+}
+
+// Writes LY and STAT back to mram and raises the STAT interrupt on a rising edge of the
+// combined STAT condition, as the hardware does.
+void ppu::update_stat() {
+    unsigned char* mem = c->mram;
+    unsigned char stat = mem[0xFF41];
+    bool coincidence = ly == mem[0xFF45];
+
+    mem[0xFF44] = static_cast<unsigned char>(ly);
+    mem[0xFF41] = 0x80 | (stat & 0x78) | (coincidence ? 0x04 : 0x00) | mode;
+
+    bool line = (coincidence && (stat & 0x40)) ||
+        (mode == 0 && (stat & 0x08)) ||
+        (mode == 1 && (stat & 0x10)) ||
+        (mode == 2 && (stat & 0x20));
+
+    if (line && !stat_line) mem[0xFF0F] |= 0x02;
+    stat_line = line;
+}
+
+void ppu::step(unsigned int cycles) {
+    unsigned char* mem = c->mram;
+
+    if (!(mem[0xFF40] & 0x80)) {
+        if (lcd_on) {
+            lcd_on = false;
+            stat_line = false;
+            ly = 0;
+            dots = 0;
+            mode = 0;
+
+            mem[0xFF44] = 0;
+            mem[0xFF41] = 0x80 | (mem[0xFF41] & 0x7C);
+        }
+        return;
+    }
+
+    if (!lcd_on) {
+        lcd_on = true;
+        ly = 0;
+        dots = 0;
+        next_event = 0;
+        start_frame();
+        set_mode(2);
+    }
+
+    dots += cycles;
+    if (dots < next_event) return;
+
+    // Lines 0-143 go through OAM scan (80 dots), transfer (172 dots) and HBlank (the rest of
+    // the 456-dot line). Lines 144-153 are VBlank.
+    while (true) {
+        if (ly < 144) {
+            if (mode == 2) {
+                if (dots < 80) { next_event = 80; break; }
+                set_mode(3);
+            } else if (mode == 3) {
+                if (dots < 252) { next_event = 252; break; }
+                if (rendering_frame) render_scanline();
+                set_mode(0);
+                if (c->hdma_active) c->hblank_dma();
+            } else {
+                if (dots < 456) { next_event = 456; break; }
+                dots -= 456;
+                ly++;
+
+                if (ly == 144) {
+                    mem[0xFF0F] |= 0x01;
+                    frame_ready = true;
+                    frame_rendered = rendering_frame;
+                    frames++;
+                    set_mode(1);
+                } else {
+                    set_mode(2);
+                }
+            }
+        } else {
+            if (dots < 456) { next_event = 456; break; }
+            dots -= 456;
+            ly++;
+
+            if (ly > 153) {
+                ly = 0;
+                start_frame();
+                set_mode(2);
+            } else {
+                update_stat();
+            }
+        }
+    }
+}
+
+// Colour index (0-3) of pixel (x, y) in the 256x256 background or window plane whose tile
+// map starts at map.
+static inline unsigned char tile_pixel(const unsigned char* mem, unsigned char lcdc, unsigned short map, unsigned int x, unsigned int y) {
+    unsigned char tile = mem[map + (y / 8) * 32 + x / 8];
+    unsigned short addr = (lcdc & 0x10) ? 0x8000 + tile * 16 : 0x9000 + static_cast<signed char>(tile) * 16;
+    addr += (y % 8) * 2;
+
+    unsigned int bit = 7 - (x % 8);
+    return (((mem[addr + 1] >> bit) & 1) << 1) | ((mem[addr] >> bit) & 1);
+}
+
+// CGB background or window pixel: the tile number comes from VRAM bank 0 and its attributes
+// (palette, tile bank, flips, priority) from the same spot in bank 1. Returns the colour index
+// and sets attr.
+static inline unsigned char cgb_tile_pixel(const unsigned char* bank0, const unsigned char* bank1, unsigned char lcdc,
+    unsigned short map, unsigned int x, unsigned int y, unsigned char& attr) {
+    unsigned int index = map - 0x8000 + (y / 8) * 32 + x / 8;
+    unsigned char tile = bank0[index];
+    attr = bank1[index];
+
+    const unsigned char* data = (attr & 0x08) ? bank1 : bank0;
+    unsigned int addr = (lcdc & 0x10) ? tile * 16 : 0x1000 + static_cast<signed char>(tile) * 16;
+    unsigned int row = (attr & 0x40) ? 7 - (y % 8) : y % 8;
+    addr += row * 2;
+
+    unsigned int bit = (attr & 0x20) ? x % 8 : 7 - (x % 8);
+    return (((data[addr + 1] >> bit) & 1) << 1) | ((data[addr] >> bit) & 1);
+}
+
+// Expands the 32 little-endian RGB555 colours of a CGB palette RAM to ARGB8888.
+static inline void cgb_colors(const unsigned char* palette, unsigned int* out) {
+    for (unsigned int i = 0; i < 32; i++) {
+        unsigned int rgb = palette[i * 2] | (palette[i * 2 + 1] << 8);
+        unsigned int r = rgb & 0x1F;
+        unsigned int g = (rgb >> 5) & 0x1F;
+        unsigned int b = (rgb >> 10) & 0x1F;
+        out[i] = 0xFF000000 | ((r << 3 | r >> 2) << 16) | ((g << 3 | g >> 2) << 8) | (b << 3 | b >> 2);
+    }
+}
+
+// CGB line composition. LCDC bit 0 no longer hides the background; it decides whether the
+// background may cover objects at all. Objects keep OAM order for priority.
+void ppu::render_scanline_cgb() {
+    const unsigned char* mem = c->mram;
+    const unsigned char* bank0 = c->vram_bank(0);
+    const unsigned char* bank1 = c->vram_bank(1);
+    unsigned char lcdc = mem[0xFF40];
+    unsigned int* line = &framebuffer[ly * pitch];
+
+    unsigned int bg_rgb[32];
+    unsigned int obj_rgb[32];
+    cgb_colors(c->bg_palette, bg_rgb);
+    cgb_colors(c->obj_palette, obj_rgb);
+
+    // Background colour index per pixel, with 0x80 set where the tile asks to be drawn over
+    // objects.
+    unsigned char bg_color[160];
+    unsigned short map = (lcdc & 0x08) ? 0x9C00 : 0x9800;
+    unsigned int y = (ly + mem[0xFF42]) & 0xFF;
+    unsigned int scx = mem[0xFF43];
+
+    for (unsigned int x = 0; x < 160; x++) {
+        unsigned char attr;
+        unsigned char color = cgb_tile_pixel(bank0, bank1, lcdc, map, (x + scx) & 0xFF, y, attr);
+        bg_color[x] = color | (attr & 0x80);
+        line[x] = bg_rgb[(attr & 7) * 4 + color];
+    }
+
+    unsigned int wy = mem[0xFF4A];
+    unsigned int wx = mem[0xFF4B];
+    if ((lcdc & 0x20) && ly >= wy && wx <= 166) {
+        unsigned short window_map = (lcdc & 0x40) ? 0x9C00 : 0x9800;
+        int start = static_cast<int>(wx) - 7;
+
+        for (int x = start < 0 ? 0 : start; x < 160; x++) {
+            unsigned char attr;
+            unsigned char color = cgb_tile_pixel(bank0, bank1, lcdc, window_map, x - start, window_line, attr);
+            bg_color[x] = color | (attr & 0x80);
+            line[x] = bg_rgb[(attr & 7) * 4 + color];
+        }
+        window_line++;
+    }
+
+    if (!(lcdc & 0x02)) return;
+
+    int height = (lcdc & 0x04) ? 16 : 8;
+    unsigned int count;
+    const unsigned char* found = objects_on_line(height, count);
+
+    for (int k = static_cast<int>(count) - 1; k >= 0; k--) {
+        const unsigned char* obj = &mem[0xFE00 + found[k] * 4];
+        int sx = obj[1] - 8;
+        unsigned char tile = obj[2];
+        unsigned char attr = obj[3];
+
+        int row = static_cast<int>(ly) - (obj[0] - 16);
+        if (attr & 0x40) row = height - 1 - row;
+        if (height == 16) tile &= 0xFE;
+
+        const unsigned char* data = (attr & 0x08) ? bank1 : bank0;
+        unsigned int addr = tile * 16 + row * 2;
+        unsigned char lo = data[addr];
+        unsigned char hi = data[addr + 1];
+        const unsigned int* colors = &obj_rgb[(attr & 7) * 4];
+
+        for (int px = 0; px < 8; px++) {
+            int x = sx + px;
+            if (x < 0 || x >= 160) continue;
+
+            unsigned int bit = (attr & 0x20) ? px : 7 - px;
+            unsigned char color = (((hi >> bit) & 1) << 1) | ((lo >> bit) & 1);
+            if (color == 0) continue;
+            if ((lcdc & 0x01) && (bg_color[x] & 0x03) != 0 && ((attr & 0x80) || (bg_color[x] & 0x80))) continue;
+
+            line[x] = colors[color];
+        }
+    }
+}
+
+void ppu::render_scanline() {
+    if (c->cgb) {
+        render_scanline_cgb();
+        return;
+    }
+
+    const unsigned char* mem = c->mram;
+    unsigned char lcdc = mem[0xFF40];
+    unsigned int* line = &framebuffer[ly * pitch];
+
+    // Raw background colour per pixel, kept for sprite-behind-background priority.
+    unsigned char bg_color[160];
+    memset(bg_color, 0, sizeof(bg_color));
+
+    if (lcdc & 0x01) {
+        unsigned short map = (lcdc & 0x08) ? 0x9C00 : 0x9800;
+        unsigned int y = (ly + mem[0xFF42]) & 0xFF;
+        unsigned int scx = mem[0xFF43];
+
+        for (unsigned int x = 0; x < 160; x++) {
+            bg_color[x] = tile_pixel(mem, lcdc, map, (x + scx) & 0xFF, y);
+        }
+
+        unsigned int wy = mem[0xFF4A];
+        unsigned int wx = mem[0xFF4B];
+        if ((lcdc & 0x20) && ly >= wy && wx <= 166) {
+            unsigned short window_map = (lcdc & 0x40) ? 0x9C00 : 0x9800;
+            int start = static_cast<int>(wx) - 7;
+
+            for (int x = start < 0 ? 0 : start; x < 160; x++) {
+                bg_color[x] = tile_pixel(mem, lcdc, window_map, x - start, window_line);
+            }
+            window_line++;
+        }
+    }
+
+    unsigned char bgp = mem[0xFF47];
+    for (unsigned int x = 0; x < 160; x++) {
+        line[x] = shades[(bgp >> (bg_color[x] * 2)) & 3];
+    }
+
+    if (!(lcdc & 0x02)) return;
+
+    // Objects come ready-ordered; the lowest priority is drawn first so higher ones overwrite it.
+    int height = (lcdc & 0x04) ? 16 : 8;
+    unsigned int count;
+    const unsigned char* found = objects_on_line(height, count);
+
+    for (int k = static_cast<int>(count) - 1; k >= 0; k--) {
+        const unsigned char* obj = &mem[0xFE00 + found[k] * 4];
+        int sx = obj[1] - 8;
+        unsigned char tile = obj[2];
+        unsigned char attr = obj[3];
+
+        int row = static_cast<int>(ly) - (obj[0] - 16);
+        if (attr & 0x40) row = height - 1 - row;
+        if (height == 16) tile &= 0xFE;
+
+        unsigned short addr = 0x8000 + tile * 16 + row * 2;
+        unsigned char lo = mem[addr];
+        unsigned char hi = mem[addr + 1];
+        unsigned char palette = (attr & 0x10) ? mem[0xFF49] : mem[0xFF48];
+
+        for (int px = 0; px < 8; px++) {
+            int x = sx + px;
+            if (x < 0 || x >= 160) continue;
+
+            unsigned int bit = (attr & 0x20) ? px : 7 - px;
+            unsigned char color = (((hi >> bit) & 1) << 1) | ((lo >> bit) & 1);
+            if (color == 0) continue;
+            if ((attr & 0x80) && bg_color[x] != 0) continue;
+
+            line[x] = shades[(palette >> (color * 2)) & 3];
+        }
+    }
+}
\ No newline at end of file
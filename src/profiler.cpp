@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include <cpu.h>
+#include <disasm.h>
+#include <opcodes.h>
+#include <profiler.h>
+
+using std::cout;
+using std::endl;
+using std::hex;
+using std::ofstream;
+using std::setfill;
+using std::setw;
+using std::vector;
+
+profiler::profiler(unsigned int rom_banks) {
+    this->rom_banks = rom_banks < 2 ? 2 : rom_banks;
+    stats.resize(this->rom_banks * 0x4000 + 0x8000);
+}
+
+void profiler::reset() {
+    std::fill(stats.begin(), stats.end(), pc_stats());
+}
+
+void profiler::slot_address(unsigned int s, unsigned int& bank, unsigned short& pc) const {
+    if (s < rom_banks * 0x4000) {
+        bank = s / 0x4000;
+        pc = static_cast<unsigned short>(bank == 0 ? s : 0x4000 + (s & 0x3FFF));
+    } else {
+        bank = 0;
+        pc = static_cast<unsigned short>(0x8000 + (s - rom_banks * 0x4000));
+    }
+}
+
+// load_rom() copies the whole cartridge image to the start of mram, so a ROM slot reads the
+// byte at the same offset. Slots above the ROM map onto the live address space.
+unsigned char profiler::code_byte(const cpu* c, unsigned int s) const {
+    if (s < rom_banks * 0x4000) return c->mram[s];
+
+    unsigned int bank;
+    unsigned short pc;
+    slot_address(s, bank, pc);
+    return c->mram[pc];
+}
+
+// A block is a run of executed instructions that follow each other in memory and ends at the
+// first control transfer, the first instruction that never ran, or a 16 KB bank boundary.
+vector<profiler::block> profiler::find_blocks(const cpu* c) const {
+    vector<block> blocks;
+    unsigned int size = static_cast<unsigned int>(stats.size());
+    unsigned int s = 0;
+
+    while (s < size) {
+        if (stats[s].count == 0) {
+            s++;
+            continue;
+        }
+
+        block b = { s, s, 0 };
+        while (true) {
+            b.last = s;
+            b.cycles += stats[s].cycles;
+
+            const opcode_info& op = opcode_lookup(code_byte(c, s), s + 1 < size ? code_byte(c, s + 1) : 0);
+            unsigned int next = s + op.length;
+
+            bool done = op.ends_block || next >= size ||
+                (next / 0x4000) != (s / 0x4000) || stats[next].count == 0;
+
+            s = next;
+            if (done) break;
+        }
+
+        blocks.push_back(b);
+    }
+
+    return blocks;
+}
+
+bool profiler::write_collapsed(const char* path, const cpu* c) const {
+    ofstream out(path);
+    if (!out.is_open()) {
+        cout << "Error: problem writing profile to " << path << endl;
+        return false;
+    }
+
+    out << hex << setfill('0');
+
+    for (const block& b : find_blocks(c)) {
+        unsigned int bank;
+        unsigned short first_pc;
+        slot_address(b.first, bank, first_pc);
+
+        for (unsigned int s = b.first; s <= b.last; ) {
+            unsigned short pc;
+            slot_address(s, bank, pc);
+
+            const opcode_info& op = opcode_lookup(code_byte(c, s), code_byte(c, s + 1));
+            unsigned char bytes[3] = { code_byte(c, s), code_byte(c, s + 1), code_byte(c, s + 2) };
+
+            out << "bank" << setw(2) << bank << ";"
+                << setw(4) << first_pc << ";"
+                << setw(4) << pc << " " << disassemble(pc, bytes) << " "
+                << std::dec << stats[s].cycles << hex << "\n";
+
+            s += op.length;
+        }
+    }
+
+    return true;
+}
+
+bool profiler::write_report(const char* path, const cpu* c, unsigned int top_n) const {
+    ofstream out(path);
+    if (!out.is_open()) {
+        cout << "Error: problem writing profile to " << path << endl;
+        return false;
+    }
+
+    unsigned long long total_cycles = 0;
+    unsigned long long total_count = 0;
+    for (const pc_stats& s : stats) {
+        total_cycles += s.cycles;
+        total_count += s.count;
+    }
+
+    vector<block> blocks = find_blocks(c);
+    std::sort(blocks.begin(), blocks.end(), [](const block& x, const block& y) {
+        return x.cycles > y.cycles;
+    });
+    if (blocks.size() > top_n) blocks.resize(top_n);
+
+    out << total_count << " instructions, " << total_cycles << " cycles" << endl << endl;
+
+    for (const block& b : blocks) {
+        unsigned int bank;
+        unsigned short pc;
+        slot_address(b.first, bank, pc);
+
+        double share = total_cycles ? 100.0 * b.cycles / total_cycles : 0.0;
+        out << "block " << hex << setfill('0') << setw(2) << bank << ":" << setw(4) << pc
+            << std::dec << setfill(' ') << "  " << b.cycles << " cycles ("
+            << std::fixed << std::setprecision(2) << share << "%)" << endl;
+
+        for (unsigned int s = b.first; s <= b.last; ) {
+            slot_address(s, bank, pc);
+            const opcode_info& op = opcode_lookup(code_byte(c, s), code_byte(c, s + 1));
+            unsigned char bytes[3] = { code_byte(c, s), code_byte(c, s + 1), code_byte(c, s + 2) };
+
+            out << "    " << hex << setfill('0') << setw(2) << bank << ":" << setw(4) << pc << "  ";
+            for (unsigned int i = 0; i < 3; i++) {
+                if (i < op.length) out << setw(2) << static_cast<unsigned int>(bytes[i]) << " ";
+                else out << "   ";
+            }
+
+            out << std::dec << setfill(' ') << std::left << setw(20) << disassemble(pc, bytes) << std::right
+                << setw(12) << stats[s].count << setw(14) << stats[s].cycles << endl;
+
+            s += op.length;
+        }
+
+        out << endl;
+    }
+
+    return true;
+}
\ No newline at end of file
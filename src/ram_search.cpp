@@ -0,0 +1,156 @@
+#include <cstring>
+
+#include <cpu.h>
+#include <ram_search.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RAM_SEARCH_SSE2 1
+#endif
+
+using std::vector;
+
+static_assert(ram_search::size % 64 == 0, "the candidate bitset holds whole words");
+
+ram_search::ram_search(cpu* c) {
+    this->c = c;
+    previous = snapshots[0];
+    current = snapshots[1];
+    reset();
+}
+
+void ram_search::capture(unsigned char* out) const {
+    memcpy(out, &c->mram[0xC000], 0x2000);
+    memcpy(out + 0x2000, &c->mram[0xFF80], 0x80);
+    memset(out + size, 0, 16);
+}
+
+void ram_search::reset() {
+    memset(candidates, 0xFF, sizeof(candidates));
+    capture(current);
+}
+
+#ifdef RAM_SEARCH_SSE2
+// Per-byte a > b for unsigned bytes.
+static inline __m128i greater_u8(__m128i a, __m128i b) {
+    return _mm_andnot_si128(_mm_cmpeq_epi8(a, b), _mm_cmpeq_epi8(_mm_max_epu8(a, b), a));
+}
+#endif
+
+// One bit per offset, set where the byte (width 1) or the word starting there (width 2) of
+// now passes op against before, or against value for equal.
+template <ram_search::compare op, unsigned int width>
+static inline unsigned int match_bits(const unsigned char* now, const unsigned char* before, unsigned int offset, unsigned int value) {
+#ifdef RAM_SEARCH_SSE2
+    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(now + offset));
+    __m128i hi = _mm_setzero_si128();
+    __m128i plo, phi;
+
+    if (width == 2) hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(now + offset + 1));
+    if (op == ram_search::equal) {
+        plo = _mm_set1_epi8(static_cast<char>(value & 0xFF));
+        phi = _mm_set1_epi8(static_cast<char>(width == 2 ? value >> 8 : 0));
+    } else {
+        plo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(before + offset));
+        phi = width == 2 ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(before + offset + 1)) : _mm_setzero_si128();
+    }
+
+    // A word compares on its high byte, and on its low byte when the high bytes are equal.
+    __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(lo, plo), _mm_cmpeq_epi8(hi, phi));
+    __m128i result;
+    if (op == ram_search::equal || op == ram_search::unchanged) {
+        result = eq;
+    } else if (op == ram_search::changed) {
+        result = _mm_andnot_si128(eq, _mm_set1_epi8(-1));
+    } else if (op == ram_search::increased) {
+        result = _mm_or_si128(greater_u8(hi, phi), _mm_and_si128(_mm_cmpeq_epi8(hi, phi), greater_u8(lo, plo)));
+    } else {
+        result = _mm_or_si128(greater_u8(phi, hi), _mm_and_si128(_mm_cmpeq_epi8(hi, phi), greater_u8(plo, lo)));
+    }
+    return static_cast<unsigned int>(_mm_movemask_epi8(result));
+#else
+    unsigned int bits = 0;
+    for (unsigned int i = 0; i < 16; i++) {
+        unsigned int a = now[offset + i];
+        unsigned int b = op == ram_search::equal ? value & (width == 2 ? 0xFFFF : 0xFF) : before[offset + i];
+        if (width == 2) {
+            a |= now[offset + i + 1] << 8;
+            if (op != ram_search::equal) b |= before[offset + i + 1] << 8;
+        }
+
+        bool pass = op == ram_search::increased ? a > b : op == ram_search::decreased ? a < b :
+            op == ram_search::changed ? a != b : a == b;
+        if (pass) bits |= 1u << i;
+    }
+    return bits;
+#endif
+}
+
+template <ram_search::compare op, unsigned int width>
+static void filter_words(unsigned long long* candidates, unsigned int words, const unsigned char* now,
+    const unsigned char* before, unsigned int value) {
+    for (unsigned int w = 0; w < words; w++) {
+        if (candidates[w] == 0) continue;
+
+        const unsigned int base = w * 64;
+        unsigned long long bits = match_bits<op, width>(now, before, base, value);
+        bits |= static_cast<unsigned long long>(match_bits<op, width>(now, before, base + 16, value)) << 16;
+        bits |= static_cast<unsigned long long>(match_bits<op, width>(now, before, base + 32, value)) << 32;
+        bits |= static_cast<unsigned long long>(match_bits<op, width>(now, before, base + 48, value)) << 48;
+        candidates[w] &= bits;
+    }
+}
+
+template <unsigned int width>
+static void filter_width(ram_search::compare op, unsigned long long* candidates, unsigned int words,
+    const unsigned char* now, const unsigned char* before, unsigned int value) {
+    switch (op) {
+        case ram_search::equal: filter_words<ram_search::equal, width>(candidates, words, now, before, value); break;
+        case ram_search::changed: filter_words<ram_search::changed, width>(candidates, words, now, before, value); break;
+        case ram_search::unchanged: filter_words<ram_search::unchanged, width>(candidates, words, now, before, value); break;
+        case ram_search::increased: filter_words<ram_search::increased, width>(candidates, words, now, before, value); break;
+        case ram_search::decreased: filter_words<ram_search::decreased, width>(candidates, words, now, before, value); break;
+    }
+}
+
+void ram_search::filter(compare op, unsigned int width, unsigned int value) {
+    unsigned char* before = current;
+    current = previous;
+    previous = before;
+    capture(current);
+
+    if (width == 2) filter_width<2>(op, candidates, words, current, previous, value);
+    else filter_width<1>(op, candidates, words, current, previous, value);
+
+    // A word can't start on the last byte of work RAM or of HRAM.
+    if (width == 2) {
+        candidates[0x2000 / 64 - 1] &= ~(1ull << 63);
+        candidates[words - 1] &= ~(1ull << 63);
+    }
+}
+
+unsigned int ram_search::count() const {
+    unsigned int total = 0;
+    for (unsigned long long w : candidates) total += static_cast<unsigned int>(__builtin_popcountll(w));
+    return total;
+}
+
+vector<unsigned short> ram_search::results(unsigned int max) const {
+    vector<unsigned short> out;
+    for (unsigned int w = 0; w < words && out.size() < max; w++) {
+        unsigned long long bits = candidates[w];
+        while (bits != 0 && out.size() < max) {
+            unsigned int bit = static_cast<unsigned int>(__builtin_ctzll(bits));
+            out.push_back(address(w * 64 + bit));
+            bits &= bits - 1;
+        }
+    }
+    return out;
+}
+
+unsigned int ram_search::value_at(unsigned short addr, unsigned int width) const {
+    unsigned int offset = addr >= 0xFF80 ? 0x2000 + addr - 0xFF80 : addr - 0xC000;
+    unsigned int v = current[offset];
+    if (width == 2) v |= current[offset + 1] << 8;
+    return v;
+}
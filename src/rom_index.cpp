@@ -0,0 +1,340 @@
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <rom_index.h>
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+namespace fs = std::filesystem;
+
+bool parse_rom_header(const unsigned char* data, unsigned long long size, rom_header& out) {
+    if (size < 0x150) return false;
+
+    memcpy(out.title, &data[0x134], 16);
+    out.title[16] = 0;
+    out.cgb_flag = data[0x143];
+    out.sgb_flag = data[0x146];
+    out.cartridge_type = data[0x147];
+    out.rom_size = data[0x148];
+    out.ram_size = data[0x149];
+    out.version = data[0x14C];
+    out.header_checksum = data[0x14D];
+    out.global_checksum = static_cast<unsigned short>(data[0x14E] << 8 | data[0x14F]);
+
+    // The title is 15 bytes when 0x143 holds the CGB flag, and 11 when 0x13F-0x142 hold the
+    // manufacturer code too; those tails aren't printable.
+    if (out.cgb_flag & 0x80) out.title[15] = 0;
+    for (unsigned int i = 0; i < 16; i++) {
+        if (out.title[i] != 0 && (out.title[i] < 0x20 || out.title[i] > 0x7E)) out.title[i] = 0;
+    }
+
+    unsigned char sum = 0;
+    for (unsigned int i = 0x134; i <= 0x14C; i++) sum = static_cast<unsigned char>(sum - data[i] - 1);
+    out.header_valid = sum == out.header_checksum;
+    return true;
+}
+
+const char* rom_mapper_name(unsigned char cartridge_type) {
+    switch (cartridge_type) {
+        case 0x00: return "ROM";
+        case 0x01: return "MBC1";
+        case 0x02: return "MBC1+RAM";
+        case 0x03: return "MBC1+RAM+BATTERY";
+        case 0x05: return "MBC2";
+        case 0x06: return "MBC2+BATTERY";
+        case 0x08: return "ROM+RAM";
+        case 0x09: return "ROM+RAM+BATTERY";
+        case 0x0B: return "MMM01";
+        case 0x0C: return "MMM01+RAM";
+        case 0x0D: return "MMM01+RAM+BATTERY";
+        case 0x0F: return "MBC3+TIMER+BATTERY";
+        case 0x10: return "MBC3+TIMER+RAM+BATTERY";
+        case 0x11: return "MBC3";
+        case 0x12: return "MBC3+RAM";
+        case 0x13: return "MBC3+RAM+BATTERY";
+        case 0x19: return "MBC5";
+        case 0x1A: return "MBC5+RAM";
+        case 0x1B: return "MBC5+RAM+BATTERY";
+        case 0x1C: return "MBC5+RUMBLE";
+        case 0x1D: return "MBC5+RUMBLE+RAM";
+        case 0x1E: return "MBC5+RUMBLE+RAM+BATTERY";
+        case 0x20: return "MBC6";
+        case 0x22: return "MBC7+SENSOR+RUMBLE+RAM+BATTERY";
+        case 0xFC: return "POCKET CAMERA";
+        case 0xFD: return "BANDAI TAMA5";
+        case 0xFE: return "HuC3";
+        case 0xFF: return "HuC1+RAM+BATTERY";
+        default: return "unknown";
+    }
+}
+
+unsigned long long rom_size_bytes(unsigned char rom_size) {
+    return rom_size <= 0x08 ? 0x8000ull << rom_size : 0;
+}
+
+unsigned long long ram_size_bytes(unsigned char ram_size) {
+    const unsigned long long sizes[] = { 0, 0x800, 0x2000, 0x8000, 0x20000, 0x10000 };
+    return ram_size < 6 ? sizes[ram_size] : 0;
+}
+
+static inline unsigned long long rotl(unsigned long long x, unsigned int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline unsigned long long load64(const unsigned char* p) {
+    unsigned long long v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static const unsigned long long prime1 = 0x9E3779B185EBCA87ull;
+static const unsigned long long prime2 = 0xC2B2AE3D27D4EB4Full;
+
+static inline unsigned long long lane(unsigned long long acc, unsigned long long v) {
+    return rotl(acc + v * prime2, 31) * prime1;
+}
+
+unsigned long long rom_hash(const unsigned char* data, unsigned long long size) {
+    unsigned long long a = prime1 + prime2, b = prime2, c = 0, d = 0 - prime1;
+    unsigned long long i = 0;
+
+    for (; i + 32 <= size; i += 32) {
+        a = lane(a, load64(data + i));
+        b = lane(b, load64(data + i + 8));
+        c = lane(c, load64(data + i + 16));
+        d = lane(d, load64(data + i + 24));
+    }
+
+    unsigned long long h = rotl(a, 1) + rotl(b, 7) + rotl(c, 12) + rotl(d, 18) + size;
+    for (; i < size; i++) h = rotl(h ^ (data[i] * prime1), 11) * prime2;
+
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    return h;
+}
+
+// Read-only view of a whole file. Hashing a mapped ROM leaves the copying to the page cache.
+class mapped_rom {
+    public:
+        const unsigned char* data = nullptr;
+        unsigned long long size = 0;
+
+        bool open(const string& path) {
+#ifdef _WIN32
+            file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE) return false;
+
+            LARGE_INTEGER length;
+            if (!GetFileSizeEx(file, &length) || length.QuadPart == 0) return false;
+            size = static_cast<unsigned long long>(length.QuadPart);
+
+            map = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (map == nullptr) return false;
+            data = static_cast<const unsigned char*>(MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0));
+#else
+            fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) return false;
+
+            off_t length = lseek(fd, 0, SEEK_END);
+            if (length <= 0) return false;
+            size = static_cast<unsigned long long>(length);
+
+            void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (view == MAP_FAILED) return false;
+            data = static_cast<const unsigned char*>(view);
+#endif
+            return data != nullptr;
+        }
+
+        ~mapped_rom() {
+#ifdef _WIN32
+            if (data != nullptr) UnmapViewOfFile(data);
+            if (map != nullptr) CloseHandle(map);
+            if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+            if (data != nullptr) munmap(const_cast<unsigned char*>(data), size);
+            if (fd >= 0) ::close(fd);
+#endif
+        }
+
+    private:
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE map = nullptr;
+#else
+        int fd = -1;
+#endif
+};
+
+bool rom_index::load(const char* path) {
+    entries.clear();
+
+    std::ifstream in(path, std::ios_base::binary);
+    if (!in.is_open()) return true;
+
+    index_file_header header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || memcmp(header.magic, "GBINDEX1", 8) != 0 ||
+        header.record_size != sizeof(index_record)) {
+        cout << "Error: " << path << " is not a rom index" << endl;
+        return false;
+    }
+
+    entries.reserve(header.count);
+    for (unsigned int i = 0; i < header.count; i++) {
+        index_record r;
+        if (!in.read(reinterpret_cast<char*>(&r), sizeof(r))) break;
+
+        rom_entry e;
+        e.path.resize(r.path_length);
+        if (!in.read(&e.path[0], r.path_length)) break;
+
+        e.mtime = r.mtime;
+        e.size = r.size;
+        e.hash = r.hash;
+        memcpy(e.header.title, r.title, 16);
+        e.header.title[16] = 0;
+        e.header.cgb_flag = r.cgb_flag;
+        e.header.sgb_flag = r.sgb_flag;
+        e.header.cartridge_type = r.cartridge_type;
+        e.header.rom_size = r.rom_size;
+        e.header.ram_size = r.ram_size;
+        e.header.version = r.version;
+        e.header.header_checksum = r.header_checksum;
+        e.header.global_checksum = r.global_checksum;
+        e.header.header_valid = r.header_valid != 0;
+        entries.push_back(e);
+    }
+
+    if (entries.size() != header.count) {
+        cout << "Error: rom index " << path << " is truncated" << endl;
+        entries.clear();
+        return false;
+    }
+    return true;
+}
+
+// Written to a temporary file and renamed over the old index, so a crash mid-write never
+// leaves a half-written index behind.
+bool rom_index::save(const char* path) const {
+    string temp = string(path) + ".tmp";
+    std::ofstream out(temp, std::ios_base::binary | std::ios_base::trunc);
+    if (!out.is_open()) {
+        cout << "Error: problem creating rom index at " << temp << endl;
+        return false;
+    }
+
+    index_file_header header;
+    memcpy(header.magic, "GBINDEX1", 8);
+    header.record_size = sizeof(index_record);
+    header.count = static_cast<unsigned int>(entries.size());
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    for (const rom_entry& e : entries) {
+        index_record r;
+        memset(&r, 0, sizeof(r));
+        r.mtime = e.mtime;
+        r.size = e.size;
+        r.hash = e.hash;
+        memcpy(r.title, e.header.title, 16);
+        r.global_checksum = e.header.global_checksum;
+        r.path_length = static_cast<unsigned short>(e.path.size());
+        r.cgb_flag = e.header.cgb_flag;
+        r.sgb_flag = e.header.sgb_flag;
+        r.cartridge_type = e.header.cartridge_type;
+        r.rom_size = e.header.rom_size;
+        r.ram_size = e.header.ram_size;
+        r.version = e.header.version;
+        r.header_checksum = e.header.header_checksum;
+        r.header_valid = e.header.header_valid;
+
+        out.write(reinterpret_cast<const char*>(&r), sizeof(r));
+        out.write(e.path.data(), r.path_length);
+    }
+
+    out.close();
+    if (!out) {
+        cout << "Error: problem writing rom index at " << temp << endl;
+        return false;
+    }
+
+    std::error_code ec;
+    fs::rename(temp, path, ec);
+    if (ec) {
+        cout << "Error: problem replacing rom index at " << path << endl;
+        return false;
+    }
+    return true;
+}
+
+static bool is_rom(const fs::path& p) {
+    string ext = p.extension().string();
+    for (char& ch : ext) ch = static_cast<char>(tolower(static_cast<unsigned char>(ch)));
+    return ext == ".gb" || ext == ".gbc";
+}
+
+bool rom_index::scan(const char* dir) {
+    std::error_code ec;
+    fs::recursive_directory_iterator it(dir, fs::directory_options::skip_permission_denied, ec);
+    if (ec) {
+        cout << "Error: problem scanning " << dir << endl;
+        return false;
+    }
+
+    std::unordered_map<string, const rom_entry*> known;
+    for (const rom_entry& e : entries) known[e.path] = &e;
+
+    vector<rom_entry> updated;
+    reused = 0;
+    opened = 0;
+
+    for (; it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        if (ec) break;
+        if (!it->is_regular_file(ec) || !is_rom(it->path())) continue;
+
+        // Size and mtime come from the directory listing; unchanged files are never opened.
+        rom_entry e;
+        e.path = it->path().generic_string();
+        e.size = static_cast<unsigned long long>(it->file_size(ec));
+        e.mtime = static_cast<unsigned long long>(it->last_write_time(ec).time_since_epoch().count());
+        if (ec) continue;
+
+        auto old = known.find(e.path);
+        if (old != known.end() && old->second->size == e.size && old->second->mtime == e.mtime) {
+            updated.push_back(*old->second);
+            reused++;
+            continue;
+        }
+
+        mapped_rom rom;
+        if (!rom.open(e.path) || !parse_rom_header(rom.data, rom.size, e.header)) continue;
+
+        e.hash = rom_hash(rom.data, rom.size);
+        updated.push_back(e);
+        opened++;
+    }
+
+    entries.swap(updated);
+    return true;
+}
+
+const rom_entry* rom_index::find(unsigned long long hash) const {
+    for (const rom_entry& e : entries) {
+        if (e.hash == hash) return &e;
+    }
+    return nullptr;
+}
\ No newline at end of file
@@ -0,0 +1,460 @@
+#include <cstring>
+
+#include <scaler.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SCALER_SSE2 1
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SCALER_AVX2 1
+#endif
+
+using std::vector;
+
+static const unsigned int border = 2;
+
+scaler::scaler(filter mode, unsigned int size_modifier) {
+    this->mode = mode;
+
+    switch (mode) {
+        case nearest: filter_factor = size_modifier > 0 ? size_modifier : 1; break;
+        case scale2x: filter_factor = 2; break;
+        case scale3x: filter_factor = 3; break;
+        case xbr: filter_factor = 2; break;
+        default: filter_factor = 1; break;
+    }
+
+    factor = filter_factor;
+    if (mode != none && size_modifier > filter_factor) factor = size_modifier - size_modifier % filter_factor;
+}
+
+bool scaler::parse(const char* name, filter& out) {
+    static const struct { const char* name; filter mode; } names[] = {
+        { "none", none }, { "nearest", nearest }, { "scale2x", scale2x }, { "scale3x", scale3x }, { "xbr", xbr },
+    };
+
+    for (const auto& n : names) {
+        if (strcmp(name, n.name) == 0) {
+            out = n.mode;
+            return true;
+        }
+    }
+    return false;
+}
+
+void scaler::run(const unsigned int* src, unsigned int src_pitch, unsigned int width, unsigned int height,
+    unsigned int* dst, unsigned int dst_pitch) {
+    if (mode == nearest || mode == none) {
+        run_nearest(src, src_pitch, width, height, dst, dst_pitch, factor);
+        return;
+    }
+
+    unsigned int* out = dst;
+    unsigned int out_pitch = dst_pitch;
+    if (factor != filter_factor) {
+        out_pitch = width * filter_factor;
+        filtered.resize(out_pitch * height * filter_factor);
+        out = filtered.data();
+    }
+
+    pad(src, src_pitch, width, height);
+    switch (mode) {
+        case scale2x: run_scale2x(width, height, out, out_pitch); break;
+        case scale3x: run_scale3x(width, height, out, out_pitch); break;
+        default: run_xbr(width, height, out, out_pitch); break;
+    }
+
+    if (factor != filter_factor) {
+        run_nearest(out, out_pitch, width * filter_factor, height * filter_factor, dst, dst_pitch, factor / filter_factor);
+    }
+}
+
+void scaler::pad(const unsigned int* src, unsigned int src_pitch, unsigned int width, unsigned int height) {
+    padded_pitch = width + border * 2;
+    padded.resize(padded_pitch * (height + border * 2));
+    if (mode == xbr) luma.resize(padded.size());
+
+    for (unsigned int y = 0; y < height + border * 2; y++) {
+        unsigned int sy = y < border ? 0 : (y - border >= height ? height - 1 : y - border);
+        const unsigned int* in = &src[sy * src_pitch];
+        unsigned int* out = &padded[y * padded_pitch];
+
+        for (unsigned int x = 0; x < border; x++) {
+            out[x] = in[0];
+            out[border + width + x] = in[width - 1];
+        }
+        memcpy(out + border, in, width * sizeof(unsigned int));
+    }
+
+    if (mode != xbr) return;
+
+    for (size_t i = 0; i < padded.size(); i++) {
+        unsigned int p = padded[i];
+        luma[i] = static_cast<unsigned short>((((p >> 16) & 0xFF) * 77 + ((p >> 8) & 0xFF) * 150 + (p & 0xFF) * 29) >> 8);
+    }
+}
+
+// Nearest neighbour
+
+#ifdef SCALER_AVX2
+// 8 source pixels become 16 (2x) or 24 (3x) through one lane permute per output vector.
+__attribute__((target("avx2")))
+static unsigned int nearest_row_avx2(const unsigned int* in, unsigned int width, unsigned int factor, unsigned int* out) {
+    unsigned int x = 0;
+
+    if (factor == 2) {
+        const __m256i lo = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+        const __m256i hi = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+        for (; x + 8 <= width; x += 8) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + x));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x * 2), _mm256_permutevar8x32_epi32(v, lo));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x * 2 + 8), _mm256_permutevar8x32_epi32(v, hi));
+        }
+    } else if (factor == 3) {
+        const __m256i p0 = _mm256_setr_epi32(0, 0, 0, 1, 1, 1, 2, 2);
+        const __m256i p1 = _mm256_setr_epi32(2, 3, 3, 3, 4, 4, 4, 5);
+        const __m256i p2 = _mm256_setr_epi32(5, 5, 6, 6, 6, 7, 7, 7);
+        for (; x + 8 <= width; x += 8) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + x));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x * 3), _mm256_permutevar8x32_epi32(v, p0));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x * 3 + 8), _mm256_permutevar8x32_epi32(v, p1));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x * 3 + 16), _mm256_permutevar8x32_epi32(v, p2));
+        }
+    }
+
+    return x;
+}
+
+static bool detect_avx2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+static const bool has_avx2 = detect_avx2();
+#endif
+
+// Returns how many source pixels were handled; the caller finishes the rest.
+static unsigned int nearest_row_sse2(const unsigned int* in, unsigned int width, unsigned int factor, unsigned int* out) {
+    unsigned int x = 0;
+
+#ifdef SCALER_SSE2
+    if (factor == 2) {
+        for (; x + 4 <= width; x += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 2), _mm_unpacklo_epi32(v, v));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 2 + 4), _mm_unpackhi_epi32(v, v));
+        }
+    } else if (factor == 3) {
+        for (; x + 4 <= width; x += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 3), _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 0, 0)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 3 + 4), _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 2, 1, 1)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 3 + 8), _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 2)));
+        }
+    } else if (factor == 4) {
+        for (; x + 4 <= width; x += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4), _mm_shuffle_epi32(v, 0x00));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4 + 4), _mm_shuffle_epi32(v, 0x55));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4 + 8), _mm_shuffle_epi32(v, 0xAA));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4 + 12), _mm_shuffle_epi32(v, 0xFF));
+        }
+    }
+#endif
+
+    return x;
+}
+
+// Each source row is widened once, then the widened row is copied by - 1 more times.
+void scaler::run_nearest(const unsigned int* src, unsigned int src_pitch, unsigned int width, unsigned int height,
+    unsigned int* dst, unsigned int dst_pitch, unsigned int by) {
+    for (unsigned int y = 0; y < height; y++) {
+        const unsigned int* in = &src[y * src_pitch];
+        unsigned int* out = &dst[y * by * dst_pitch];
+
+        unsigned int x = 0;
+#ifdef SCALER_AVX2
+        if (has_avx2) x = nearest_row_avx2(in, width, by, out);
+#endif
+        if (x == 0) x = nearest_row_sse2(in, width, by, out);
+
+        for (; x < width; x++) {
+            for (unsigned int i = 0; i < by; i++) out[x * by + i] = in[x];
+        }
+
+        for (unsigned int i = 1; i < by; i++) {
+            memcpy(out + i * dst_pitch, out, width * by * sizeof(unsigned int));
+        }
+    }
+}
+
+// Scale2x / Scale3x (AdvMAME). With E the source pixel and
+//
+//     A B C
+//     D E F
+//     G H I
+//
+// its neighbours, each output pixel takes a neighbour's colour where two neighbours meet along
+// an edge through that corner, and E otherwise.
+
+#ifdef SCALER_SSE2
+static inline __m128i pick(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static inline __m128i load4(const unsigned int* p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+static inline void store4(unsigned int* p, __m128i v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+}
+
+// Interleaves three vectors into a0 b0 c0 a1 b1 c1 a2 b2 c2 a3 b3 c3.
+static inline void store3(unsigned int* p, __m128i a, __m128i b, __m128i c) {
+    __m128i a_next = _mm_srli_si128(a, 4);
+    __m128 ab_lo = _mm_castsi128_ps(_mm_unpacklo_epi32(a, b));
+    __m128 ab_hi = _mm_castsi128_ps(_mm_unpackhi_epi32(a, b));
+    __m128 bc_lo = _mm_castsi128_ps(_mm_unpacklo_epi32(b, c));
+    __m128 bc_hi = _mm_castsi128_ps(_mm_unpackhi_epi32(b, c));
+    __m128 ca_lo = _mm_castsi128_ps(_mm_unpacklo_epi32(c, a_next));
+    __m128 ca_hi = _mm_castsi128_ps(_mm_unpackhi_epi32(c, a_next));
+
+    store4(p, _mm_castps_si128(_mm_shuffle_ps(ab_lo, ca_lo, _MM_SHUFFLE(1, 0, 1, 0))));
+    store4(p + 4, _mm_castps_si128(_mm_shuffle_ps(bc_lo, ab_hi, _MM_SHUFFLE(1, 0, 3, 2))));
+    store4(p + 8, _mm_castps_si128(_mm_shuffle_ps(ca_hi, bc_hi, _MM_SHUFFLE(3, 2, 1, 0))));
+}
+#endif
+
+void scaler::run_scale2x(unsigned int width, unsigned int height, unsigned int* dst, unsigned int dst_pitch) {
+    int pitch = static_cast<int>(padded_pitch);
+
+    for (unsigned int y = 0; y < height; y++) {
+        const unsigned int* e = &padded[(y + border) * padded_pitch + border];
+        const unsigned int* b = e - padded_pitch;
+        const unsigned int* h = e + padded_pitch;
+        unsigned int* out0 = &dst[y * 2 * dst_pitch];
+        unsigned int* out1 = out0 + dst_pitch;
+
+        unsigned int x = 0;
+#ifdef SCALER_SSE2
+        const __m128i ones = _mm_set1_epi32(-1);
+        for (; x + 4 <= width; x += 4) {
+            __m128i B = load4(b + x), D = load4(e + x - 1), E = load4(e + x), F = load4(e + x + 1), H = load4(h + x);
+
+            __m128i edge = _mm_andnot_si128(_mm_or_si128(_mm_cmpeq_epi32(B, H), _mm_cmpeq_epi32(D, F)), ones);
+            __m128i e0 = pick(_mm_and_si128(edge, _mm_cmpeq_epi32(D, B)), D, E);
+            __m128i e1 = pick(_mm_and_si128(edge, _mm_cmpeq_epi32(B, F)), F, E);
+            __m128i e2 = pick(_mm_and_si128(edge, _mm_cmpeq_epi32(D, H)), D, E);
+            __m128i e3 = pick(_mm_and_si128(edge, _mm_cmpeq_epi32(H, F)), F, E);
+
+            store4(out0 + x * 2, _mm_unpacklo_epi32(e0, e1));
+            store4(out0 + x * 2 + 4, _mm_unpackhi_epi32(e0, e1));
+            store4(out1 + x * 2, _mm_unpacklo_epi32(e2, e3));
+            store4(out1 + x * 2 + 4, _mm_unpackhi_epi32(e2, e3));
+        }
+#endif
+
+        for (; x < width; x++) {
+            const unsigned int* p = e + x;
+            unsigned int B = p[-pitch], D = p[-1], E = p[0], F = p[1], H = p[pitch];
+            bool edge = B != H && D != F;
+
+            out0[x * 2] = edge && D == B ? D : E;
+            out0[x * 2 + 1] = edge && B == F ? F : E;
+            out1[x * 2] = edge && D == H ? D : E;
+            out1[x * 2 + 1] = edge && H == F ? F : E;
+        }
+    }
+}
+
+void scaler::run_scale3x(unsigned int width, unsigned int height, unsigned int* dst, unsigned int dst_pitch) {
+    int pitch = static_cast<int>(padded_pitch);
+
+    for (unsigned int y = 0; y < height; y++) {
+        const unsigned int* e = &padded[(y + border) * padded_pitch + border];
+        const unsigned int* b = e - padded_pitch;
+        const unsigned int* h = e + padded_pitch;
+        unsigned int* out0 = &dst[y * 3 * dst_pitch];
+        unsigned int* out1 = out0 + dst_pitch;
+        unsigned int* out2 = out1 + dst_pitch;
+
+        unsigned int x = 0;
+#ifdef SCALER_SSE2
+        const __m128i ones = _mm_set1_epi32(-1);
+        for (; x + 4 <= width; x += 4) {
+            __m128i A = load4(b + x - 1), B = load4(b + x), C = load4(b + x + 1);
+            __m128i D = load4(e + x - 1), E = load4(e + x), F = load4(e + x + 1);
+            __m128i G = load4(h + x - 1), H = load4(h + x), I = load4(h + x + 1);
+
+            __m128i edge = _mm_andnot_si128(_mm_or_si128(_mm_cmpeq_epi32(B, H), _mm_cmpeq_epi32(D, F)), ones);
+            __m128i db = _mm_and_si128(edge, _mm_cmpeq_epi32(D, B));
+            __m128i bf = _mm_and_si128(edge, _mm_cmpeq_epi32(B, F));
+            __m128i dh = _mm_and_si128(edge, _mm_cmpeq_epi32(D, H));
+            __m128i hf = _mm_and_si128(edge, _mm_cmpeq_epi32(H, F));
+            __m128i ea = _mm_cmpeq_epi32(E, A), ec = _mm_cmpeq_epi32(E, C);
+            __m128i eg = _mm_cmpeq_epi32(E, G), ei = _mm_cmpeq_epi32(E, I);
+
+            __m128i e0 = pick(db, D, E);
+            __m128i e1 = pick(_mm_or_si128(_mm_andnot_si128(ec, db), _mm_andnot_si128(ea, bf)), B, E);
+            __m128i e2 = pick(bf, F, E);
+            __m128i e3 = pick(_mm_or_si128(_mm_andnot_si128(eg, db), _mm_andnot_si128(ea, dh)), D, E);
+            __m128i e5 = pick(_mm_or_si128(_mm_andnot_si128(ei, bf), _mm_andnot_si128(ec, hf)), F, E);
+            __m128i e6 = pick(dh, D, E);
+            __m128i e7 = pick(_mm_or_si128(_mm_andnot_si128(ei, dh), _mm_andnot_si128(eg, hf)), H, E);
+            __m128i e8 = pick(hf, F, E);
+
+            store3(out0 + x * 3, e0, e1, e2);
+            store3(out1 + x * 3, e3, E, e5);
+            store3(out2 + x * 3, e6, e7, e8);
+        }
+#endif
+
+        for (; x < width; x++) {
+            const unsigned int* p = e + x;
+            unsigned int A = p[-pitch - 1], B = p[-pitch], C = p[-pitch + 1];
+            unsigned int D = p[-1], E = p[0], F = p[1];
+            unsigned int G = p[pitch - 1], H = p[pitch], I = p[pitch + 1];
+            bool edge = B != H && D != F;
+            bool db = edge && D == B, bf = edge && B == F, dh = edge && D == H, hf = edge && H == F;
+
+            out0[x * 3] = db ? D : E;
+            out0[x * 3 + 1] = (db && E != C) || (bf && E != A) ? B : E;
+            out0[x * 3 + 2] = bf ? F : E;
+            out1[x * 3] = (db && E != G) || (dh && E != A) ? D : E;
+            out1[x * 3 + 1] = E;
+            out1[x * 3 + 2] = (bf && E != I) || (hf && E != C) ? F : E;
+            out2[x * 3] = dh ? D : E;
+            out2[x * 3 + 1] = (dh && E != I) || (hf && E != G) ? H : E;
+            out2[x * 3 + 2] = hf ? F : E;
+        }
+    }
+}
+
+// xBR-lite, 2x. For each output corner of E, xBR compares the total luma difference across
+// the two diagonals through that corner (weighted over a 4x4 neighbourhood). When the edge
+// runs along the corner, that output pixel becomes a 50% blend of E and whichever of the two
+// side neighbours is closer to E. Full xBR also grades the blend by edge angle; this doesn't.
+// The edge test runs on 8 pixels at a time in 16-bit luma, and only corners with an edge go
+// through the scalar blend.
+
+static inline unsigned int blend(unsigned int a, unsigned int b) {
+    return (((a & 0xFEFEFEFE) >> 1) + ((b & 0xFEFEFEFE) >> 1)) | 0xFF000000;
+}
+
+static inline int luma_diff(int a, int b) {
+    return a > b ? a - b : b - a;
+}
+
+// Whether the corner of E towards (sx, sy) lies on an edge, and if so (via pick_h) whether
+// it blends towards the vertical neighbour rather than the horizontal one.
+static inline bool xbr_corner(const unsigned short* l, int pitch, int sx, int sy, bool& pick_h) {
+    int dy = sy * pitch;
+    int E = l[0], B = l[-dy], C = l[sx - dy], D = l[-sx], F = l[sx];
+    int G = l[-sx + dy], H = l[dy], I = l[sx + dy];
+    int F4 = l[2 * sx], I4 = l[2 * sx + dy], H5 = l[2 * dy], I5 = l[sx + 2 * dy];
+
+    int along = luma_diff(E, C) + luma_diff(E, G) + luma_diff(I, F4) + luma_diff(I, H5) + 4 * luma_diff(H, F);
+    int across = luma_diff(H, D) + luma_diff(H, I5) + luma_diff(F, I4) + luma_diff(F, B) + 4 * luma_diff(E, I);
+
+    int ef = luma_diff(E, F);
+    int eh = luma_diff(E, H);
+    pick_h = eh < ef;
+    return along < across && ef != 0 && eh != 0;
+}
+
+#ifdef SCALER_SSE2
+static inline __m128i load16(const unsigned short* p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+static inline __m128i absdiff16(__m128i a, __m128i b) {
+    return _mm_or_si128(_mm_subs_epu16(a, b), _mm_subs_epu16(b, a));
+}
+
+// Vector form of xbr_corner for 8 pixels; returns the edge mask and sets pick_h.
+static inline __m128i xbr_corner_sse2(const unsigned short* l, int pitch, int sx, int sy, __m128i& pick_h) {
+    int dy = sy * pitch;
+    __m128i E = load16(l), B = load16(l - dy), C = load16(l + sx - dy), D = load16(l - sx), F = load16(l + sx);
+    __m128i G = load16(l - sx + dy), H = load16(l + dy), I = load16(l + sx + dy);
+    __m128i F4 = load16(l + 2 * sx), I4 = load16(l + 2 * sx + dy), H5 = load16(l + 2 * dy), I5 = load16(l + sx + 2 * dy);
+
+    __m128i along = _mm_add_epi16(_mm_add_epi16(absdiff16(E, C), absdiff16(E, G)),
+        _mm_add_epi16(_mm_add_epi16(absdiff16(I, F4), absdiff16(I, H5)), _mm_slli_epi16(absdiff16(H, F), 2)));
+    __m128i across = _mm_add_epi16(_mm_add_epi16(absdiff16(H, D), absdiff16(H, I5)),
+        _mm_add_epi16(_mm_add_epi16(absdiff16(F, I4), absdiff16(F, B)), _mm_slli_epi16(absdiff16(E, I), 2)));
+
+    __m128i ef = absdiff16(E, F);
+    __m128i eh = absdiff16(E, H);
+    __m128i zero = _mm_setzero_si128();
+    pick_h = _mm_cmplt_epi16(eh, ef);
+
+    __m128i edge = _mm_cmplt_epi16(along, across);
+    edge = _mm_andnot_si128(_mm_cmpeq_epi16(ef, zero), edge);
+    return _mm_andnot_si128(_mm_cmpeq_epi16(eh, zero), edge);
+}
+#endif
+
+#ifdef SCALER_SSE2
+static inline __m128i blend4(__m128i a, __m128i b) {
+    const __m128i low_bits = _mm_set1_epi32(0xFEFEFEFE);
+    __m128i sum = _mm_add_epi32(_mm_srli_epi32(_mm_and_si128(a, low_bits), 1), _mm_srli_epi32(_mm_and_si128(b, low_bits), 1));
+    return _mm_or_si128(sum, _mm_set1_epi32(0xFF000000));
+}
+
+// Output for the left and right corners on one side (sy) of four source pixels at p, from the
+// 32-bit widened edge masks; the pair is interleaved into 8 output pixels.
+static inline void xbr_store(unsigned int* out, const unsigned int* p, int vertical,
+    __m128i edge_l, __m128i pick_l, __m128i edge_r, __m128i pick_r) {
+    __m128i E = load4(p);
+    __m128i V = load4(p + vertical);
+
+    __m128i left = pick(edge_l, blend4(E, pick(pick_l, V, load4(p - 1))), E);
+    __m128i right = pick(edge_r, blend4(E, pick(pick_r, V, load4(p + 1))), E);
+
+    store4(out, _mm_unpacklo_epi32(left, right));
+    store4(out + 4, _mm_unpackhi_epi32(left, right));
+}
+#endif
+
+void scaler::run_xbr(unsigned int width, unsigned int height, unsigned int* dst, unsigned int dst_pitch) {
+    int pitch = static_cast<int>(padded_pitch);
+
+    for (unsigned int y = 0; y < height; y++) {
+        const unsigned int* e = &padded[(y + border) * padded_pitch + border];
+        const unsigned short* l = &luma[(y + border) * padded_pitch + border];
+
+        for (int sy = -1; sy <= 1; sy += 2) {
+            unsigned int* row = &dst[(y * 2 + (sy > 0 ? 1 : 0)) * dst_pitch];
+
+            unsigned int x = 0;
+#ifdef SCALER_SSE2
+            for (; x + 8 <= width; x += 8) {
+                __m128i pick_l, pick_r;
+                __m128i edge_l = xbr_corner_sse2(l + x, pitch, -1, sy, pick_l);
+                __m128i edge_r = xbr_corner_sse2(l + x, pitch, 1, sy, pick_r);
+
+                xbr_store(row + x * 2, e + x, sy * pitch,
+                    _mm_unpacklo_epi16(edge_l, edge_l), _mm_unpacklo_epi16(pick_l, pick_l),
+                    _mm_unpacklo_epi16(edge_r, edge_r), _mm_unpacklo_epi16(pick_r, pick_r));
+                xbr_store(row + x * 2 + 8, e + x + 4, sy * pitch,
+                    _mm_unpackhi_epi16(edge_l, edge_l), _mm_unpackhi_epi16(pick_l, pick_l),
+                    _mm_unpackhi_epi16(edge_r, edge_r), _mm_unpackhi_epi16(pick_r, pick_r));
+            }
+#endif
+
+            for (; x < width; x++) {
+                const unsigned int* p = e + x;
+                for (int sx = -1; sx <= 1; sx += 2) {
+                    bool pick_h;
+                    unsigned int c = *p;
+                    if (xbr_corner(l + x, pitch, sx, sy, pick_h)) c = blend(*p, pick_h ? p[sy * pitch] : p[sx]);
+                    row[x * 2 + (sx > 0 ? 1 : 0)] = c;
+                }
+            }
+        }
+    }
+}
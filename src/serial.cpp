@@ -0,0 +1,212 @@
+#include <chrono>
+#include <iostream>
+
+#include <cpu.h>
+#include <serial.h>
+
+using std::cout;
+using std::endl;
+
+// 8 bits at 8192 Hz.
+static const unsigned int transfer_cycles = 4096;
+
+// How often the peer is checked for transfers: often while SC is armed on the external
+// clock, rarely otherwise (an unarmed port answers 0xFF either way).
+static const unsigned int poll_armed = 1024;
+static const unsigned int poll_idle = 8192;
+
+void local_link::make_pair(std::unique_ptr<local_link>& a, std::unique_ptr<local_link>& b) {
+    std::shared_ptr<queue> a_to_b = std::make_shared<queue>();
+    std::shared_ptr<queue> b_to_a = std::make_shared<queue>();
+
+    a.reset(new local_link());
+    b.reset(new local_link());
+    a->out = a_to_b;
+    a->in = b_to_a;
+    b->out = b_to_a;
+    b->in = a_to_b;
+}
+
+local_link::~local_link() {
+    for (const std::shared_ptr<queue>& q : { in, out }) {
+        if (!q) continue;
+        std::lock_guard<std::mutex> guard(q->lock);
+        q->closed = true;
+        q->ready.notify_all();
+    }
+}
+
+bool local_link::send(message m) {
+    std::lock_guard<std::mutex> guard(out->lock);
+    if (out->closed) {
+        connected = false;
+        return false;
+    }
+    out->items.push_back(m);
+    out->ready.notify_one();
+    return true;
+}
+
+bool local_link::receive(message& m, bool wait) {
+    std::unique_lock<std::mutex> guard(in->lock);
+    if (wait) in->ready.wait(guard, [this]() { return !in->items.empty() || in->closed; });
+
+    if (in->items.empty()) {
+        if (in->closed) connected = false;
+        return false;
+    }
+    m = in->items.front();
+    in->items.pop_front();
+    return true;
+}
+
+void local_link::wait_for_message(unsigned int ms) {
+    std::unique_lock<std::mutex> guard(in->lock);
+    in->ready.wait_for(guard, std::chrono::milliseconds(ms), [this]() { return !in->items.empty(); });
+}
+
+socket_link::~socket_link() {
+    net_close(s);
+}
+
+bool socket_link::listen(const char* address) {
+    net_socket listener = net_listen(address);
+    if (listener == net_invalid) return false;
+
+    cout << "Waiting for link peer on " << address << endl;
+    s = net_accept(listener);
+    net_close(listener);
+    return s != net_invalid;
+}
+
+bool socket_link::connect(const char* address) {
+    s = net_connect(address);
+    return s != net_invalid;
+}
+
+bool socket_link::send(message m) {
+    unsigned char bytes[2] = { m.type, m.data };
+    if (!net_send(s, bytes, sizeof(bytes))) connected = false;
+    return connected;
+}
+
+bool socket_link::receive(message& m, bool wait) {
+    if (!connected) return false;
+
+    unsigned char bytes[2];
+    int got = net_recv(s, bytes, 2, wait);
+    if (got == 0) return false;
+    if (got == 1) got += net_recv(s, bytes + 1, 1, true) == 1 ? 1 : 0;
+
+    if (got != 2) {
+        connected = false;
+        return false;
+    }
+    m = { bytes[0], bytes[1] };
+    return true;
+}
+
+serial::serial(cpu* c) {
+    this->c = c;
+    cycles = &c->cycles;
+    schedule();
+}
+
+void serial::write(unsigned short addr, unsigned char value) {
+    unsigned char* mem = c->mram;
+    mem[addr] = value;
+
+    // A transfer on the internal clock makes this side the master: the exchange with the
+    // peer happens now, and the result lands when the 8 bits have been shifted.
+    if (addr == 0xFF02 && (value & 0x81) == 0x81 && !active) {
+        active = true;
+        incoming = 0xFF;
+        done_at = *cycles + transfer_cycles;
+
+        if (link != nullptr && link->connected) {
+            link->send({ start, mem[0xFF01] });
+
+            // Answer the peer's own transfers while waiting, so two masters can't deadlock.
+            link_transport::message m;
+            while (link->receive(m, true)) {
+                if (m.type == reply) {
+                    incoming = m.data;
+                    break;
+                }
+                if (m.type == start) link->send({ reply, answer(m.data) });
+            }
+        }
+    }
+
+    schedule();
+}
+
+void serial::update() {
+    if (active && *cycles >= done_at) {
+        active = false;
+        complete(incoming);
+    }
+
+    answer_peer(true);
+    schedule();
+}
+
+void serial::schedule() {
+    next_event = ~0ull;
+
+    if (link != nullptr && link->connected) {
+        next_event = *cycles + ((c->mram[0xFF02] & 0x81) == 0x80 ? poll_armed : poll_idle);
+    }
+    if (active && done_at < next_event) next_event = done_at;
+    if (pending && answer_at < next_event) next_event = answer_at;
+}
+
+void serial::poll() {
+    answer_peer(false);
+    schedule();
+}
+
+// With hold set, a transfer from the peer is held until this side's clock is a full transfer
+// past the last one it answered, so the game gets the time real hardware gives it to take the
+// byte and re-arm, however far apart the two instances' clocks are. The peer is blocked until
+// the reply, so hold is only for a running instance.
+void serial::answer_peer(bool hold) {
+    if (link == nullptr || !link->connected) return;
+
+    link_transport::message m;
+    while (pending || link->receive(m, false)) {
+        if (pending) m = { start, pending_data };
+        if (m.type != start) continue;
+
+        if (hold && *cycles < answer_at) {
+            pending = true;
+            pending_data = m.data;
+            break;
+        }
+
+        pending = false;
+        link->send({ reply, answer(m.data) });
+        answer_at = *cycles + transfer_cycles;
+    }
+
+    if (!link->connected) cout << "Link peer disconnected" << endl;
+}
+
+// The peer's transfer shifts its byte in and ours out, if this side is armed on the external
+// clock; otherwise the peer sees an unplugged cable.
+unsigned char serial::answer(unsigned char data) {
+    unsigned char* mem = c->mram;
+    if ((mem[0xFF02] & 0x81) != 0x80) return 0xFF;
+
+    unsigned char out = mem[0xFF01];
+    complete(data);
+    return out;
+}
+
+void serial::complete(unsigned char data) {
+    unsigned char* mem = c->mram;
+    mem[0xFF01] = data;
+    mem[0xFF02] &= 0x7F;
+    mem[0xFF0F] |= 0x08;
+    transfers++;
+}
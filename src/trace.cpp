@@ -0,0 +1,104 @@
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <trace.h>
+
+using std::cout;
+using std::endl;
+
+trace_buffer::trace_buffer() {}
+
+trace_buffer::~trace_buffer() {
+    close();
+}
+
+bool trace_buffer::open(const char* path, unsigned int capacity) {
+    close();
+
+    unsigned int rounded = 1;
+    while (rounded < capacity && rounded < 0x80000000u) rounded <<= 1;
+    capacity = rounded;
+    mapped_size = sizeof(trace_header) + static_cast<unsigned long long>(capacity) * sizeof(trace_record);
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        cout << "Error: problem creating trace at " << path << endl;
+        return false;
+    }
+
+    HANDLE map = CreateFileMappingA(file, nullptr, PAGE_READWRITE,
+        static_cast<DWORD>(mapped_size >> 32), static_cast<DWORD>(mapped_size & 0xFFFFFFFF), nullptr);
+    void* view = map ? MapViewOfFile(map, FILE_MAP_WRITE, 0, 0, 0) : nullptr;
+    if (view == nullptr) {
+        if (map) CloseHandle(map);
+        CloseHandle(file);
+        cout << "Error: problem mapping trace at " << path << endl;
+        return false;
+    }
+
+    file_handle = file;
+    map_handle = map;
+    mapping = view;
+#else
+    fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        cout << "Error: problem creating trace at " << path << endl;
+        return false;
+    }
+
+    void* view = MAP_FAILED;
+    if (ftruncate(fd, static_cast<off_t>(mapped_size)) == 0) {
+        view = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+
+    if (view == MAP_FAILED) {
+        ::close(fd);
+        fd = -1;
+        cout << "Error: problem mapping trace at " << path << endl;
+        return false;
+    }
+
+    mapping = view;
+#endif
+
+    header = static_cast<trace_header*>(mapping);
+    records = reinterpret_cast<trace_record*>(header + 1);
+
+    memcpy(header->magic, "GBTRACE1", 8);
+    header->record_size = sizeof(trace_record);
+    header->capacity = capacity;
+    header->head = 0;
+    head = 0;
+    mask = capacity - 1;
+
+    return true;
+}
+
+void trace_buffer::close() {
+    if (mapping == nullptr) return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(mapping);
+    CloseHandle(map_handle);
+    CloseHandle(file_handle);
+    map_handle = nullptr;
+    file_handle = nullptr;
+#else
+    munmap(mapping, mapped_size);
+    ::close(fd);
+    fd = -1;
+#endif
+
+    mapping = nullptr;
+    header = nullptr;
+    records = nullptr;
+}
\ No newline at end of file
@@ -0,0 +1,403 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <cpu.h>
+#include <ppu.h>
+#include <profiler.h>
+#include <ram_search.h>
+#include <scaler.h>
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+// Microbenchmarks for the emulator core and PPU. Results are printed as JSON in the same layout
+// as Google Benchmark's --benchmark_format=json, so two runs can be diffed with its
+// compare.py script to catch regressions between commits.
+//
+// Usage: bench [--json | --console] [--min-time seconds] [rom ...]
+
+typedef std::chrono::steady_clock bench_clock;
+
+struct bench_result {
+    string name;
+    unsigned long long iterations;
+    double ns_per_iter;
+    double items_per_second;
+};
+
+static double min_time = 0.2;
+static vector<bench_result> results;
+
+// Lays out one instruction per 4-byte slot starting at 0x0100, so every slot can be executed
+// by pointing the program counter at it. This keeps a family benchmark independent of how far
+// each handler advances PC.
+struct op_family {
+    const char* name;
+    vector<vector<unsigned char>> ops;
+};
+
+static const unsigned short slot_base = 0x0100;
+
+static void reset_cpu(cpu* c) {
+    memset(c->mram, 0, 0x10000);
+
+    c->set_af(0x01B0);
+    c->set_bc(0x0013);
+    c->set_de(0x00D8);
+    c->set_hl(0xC000);
+    c->stack_pointer = 0xFFFE;
+    c->prog_counter = slot_base;
+}
+
+// Runs body(n) with a growing batch size until the total time exceeds min_time, then records
+// the mean cost of one item.
+template <typename F>
+static void run_bench(const string& name, unsigned long long items_per_batch, F body) {
+    unsigned long long batches = 1;
+
+    while (true) {
+        bench_clock::time_point start = bench_clock::now();
+        for (unsigned long long i = 0; i < batches; i++) body();
+        double elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+
+        if (elapsed >= min_time || batches >= (1ull << 40)) {
+            unsigned long long items = batches * items_per_batch;
+            results.push_back({ name, items, elapsed * 1e9 / items, items / elapsed });
+            return;
+        }
+
+        batches *= (elapsed < min_time / 10) ? 10 : 2;
+    }
+}
+
+static void bench_opcodes(cpu* c) {
+    // Only opcodes with a handler in cpu::read() are listed; anything else would time the
+    // "unknown opcode" print instead of the interpreter.
+    vector<op_family> families = {
+        { "nop", { { 0x00 } } },
+        { "ld_r_r", { { 0x40 }, { 0x41 }, { 0x42 }, { 0x50 }, { 0x53 }, { 0x61 }, { 0x47 }, { 0x57 }, { 0x78 }, { 0x68 } } },
+        { "ld_r_d8", { { 0x06, 0x12 }, { 0x16, 0x34 }, { 0x26, 0xC0 } } },
+        { "ld_r_hl", { { 0x46 }, { 0x56 } } },
+        { "ld_hl_r", { { 0x70 }, { 0x71 }, { 0x72 }, { 0x73 }, { 0x77 } } },
+        { "ld_rr_d16", { { 0x01, 0x34, 0x12 }, { 0x11, 0x78, 0x56 }, { 0x31, 0xFE, 0xFF } } },
+        { "alu_r", { { 0x80 }, { 0x91 }, { 0xA2 }, { 0xB3 }, { 0x88 }, { 0x98 }, { 0xA8 }, { 0xB8 } } },
+        { "alu_hl", { { 0x86 }, { 0x96 }, { 0xA6 }, { 0xB6 } } },
+        { "alu_d8", { { 0xC6, 0x01 }, { 0xD6, 0x01 }, { 0xE6, 0x0F }, { 0xF6, 0xF0 } } },
+        { "inc_dec_r", { { 0x04 }, { 0x14 }, { 0x05 }, { 0x15 } } },
+        { "inc_dec_hl", { { 0x34 }, { 0x35 } } },
+        { "inc_rr", { { 0x03 }, { 0x13 }, { 0x33 } } },
+        { "rotate_a", { { 0x07 }, { 0x17 } } },
+        { "jr", { { 0x18, 0x02 }, { 0x20, 0x02 }, { 0x28, 0x02 }, { 0x30, 0x02 }, { 0x38, 0x02 } } },
+        { "jp", { { 0xC3, 0x00, 0x01 }, { 0xC2, 0x00, 0x01 }, { 0xD2, 0x00, 0x01 } } },
+        { "rst", { { 0xC7 }, { 0xCF }, { 0xD7 }, { 0xFF } } },
+        { "pop", { { 0xC1 }, { 0xD1 }, { 0xE1 } } },
+        { "ldh", { { 0xE0, 0x40 }, { 0xF0, 0x40 }, { 0xE2 }, { 0xF2 } } },
+    };
+
+    for (op_family& family : families) {
+        reset_cpu(c);
+
+        unsigned int slots = static_cast<unsigned int>(family.ops.size());
+        for (unsigned int i = 0; i < slots; i++) {
+            memcpy(&c->mram[slot_base + i * 4], family.ops[i].data(), family.ops[i].size());
+        }
+
+        const unsigned int batch = 4096;
+        run_bench("BM_opcode/" + string(family.name), batch, [&]() {
+            for (unsigned int i = 0; i < batch; i++) {
+                c->prog_counter = slot_base + (i % slots) * 4;
+                c->stack_pointer = 0xFFF0;
+                c->read();
+            }
+        });
+    }
+}
+
+struct mem_region {
+    const char* name;
+    unsigned short base;
+};
+
+// Memory is timed through LD B, (HL) and LD (HL), B since those are the interpreter's
+// load/store path; HL walks a 64-byte window inside each region.
+static void bench_memory(cpu* c) {
+    vector<mem_region> regions = {
+        { "rom", 0x0200 },
+        { "vram", 0x8000 },
+        { "eram", 0xA000 },
+        { "wram", 0xC000 },
+        { "oam", 0xFE00 },
+        { "io", 0xFF00 },
+        { "hram", 0xFF80 },
+    };
+
+    const unsigned int batch = 4096;
+    for (mem_region& region : regions) {
+        reset_cpu(c);
+        c->mram[slot_base] = 0x46;
+        c->mram[slot_base + 4] = 0x70;
+
+        run_bench("BM_bus_read/" + string(region.name), batch, [&]() {
+            for (unsigned int i = 0; i < batch; i++) {
+                c->set_hl(region.base + (i & 0x3F));
+                c->prog_counter = slot_base;
+                c->read();
+            }
+        });
+
+        run_bench("BM_bus_write/" + string(region.name), batch, [&]() {
+            for (unsigned int i = 0; i < batch; i++) {
+                c->set_hl(region.base + (i & 0x3F));
+                c->prog_counter = slot_base + 4;
+                c->read();
+            }
+        });
+    }
+}
+
+// Upscales one rendered frame; nearest runs at the window's size_modifier of 3.
+static void bench_scalers(const unsigned int* frame) {
+    const char* names[] = { "nearest", "scale2x", "scale3x", "xbr" };
+
+    for (const char* name : names) {
+        scaler::filter filter;
+        scaler::parse(name, filter);
+        scaler s(filter, 3);
+
+        unsigned int w = 160 * s.factor;
+        vector<unsigned int> out(w * 144 * s.factor);
+        run_bench(string("BM_scaler/") + name, 1, [&]() { s.run(frame, 160, 160, 144, out.data(), w); });
+    }
+}
+
+static void bench_state(cpu* c) {
+    reset_cpu(c);
+    ppu* gpu = new ppu(c);
+    cpu::state* snapshot = new cpu::state();
+    ppu::state ppu_snapshot;
+
+    run_bench("BM_state/save", 1, [&]() {
+        c->save_state(*snapshot);
+        gpu->save_state(ppu_snapshot);
+    });
+    run_bench("BM_state/restore", 1, [&]() {
+        c->load_state(*snapshot);
+        gpu->load_state(ppu_snapshot);
+    });
+
+    delete snapshot;
+    delete gpu;
+}
+
+// One RAM search step over random memory; a few bytes change between steps so the candidate
+// set doesn't empty out.
+static void bench_ram_search(cpu* c) {
+    reset_cpu(c);
+    for (unsigned int i = 0xC000; i < 0x10000; i++) c->mram[i] = static_cast<unsigned char>(rand());
+
+    ram_search* search = new ram_search(c);
+    unsigned int n = 0;
+
+    run_bench("BM_ram_search/changed8", 1, [&]() {
+        c->mram[0xC000 + (n++ & 0x1FFF)]++;
+        search->filter(ram_search::changed, 1);
+        search->reset();
+    });
+    run_bench("BM_ram_search/increased16", 1, [&]() {
+        c->mram[0xC000 + (n++ & 0x1FFF)]++;
+        search->filter(ram_search::increased, 2);
+        search->reset();
+    });
+
+    delete search;
+}
+
+// PPU cost with a busy screen: random tiles and maps, the window on, and all 40 objects placed
+// on visible lines. Frames are stepped 4 cycles at a time like the main loop does.
+static void bench_ppu(cpu* c) {
+    reset_cpu(c);
+
+    unsigned int seed = 12345;
+    for (unsigned int addr = 0x8000; addr < 0xA000; addr++) {
+        seed = seed * 1103515245 + 12345;
+        c->mram[addr] = static_cast<unsigned char>(seed >> 16);
+    }
+    for (unsigned int i = 0; i < 40; i++) {
+        c->mram[0xFE00 + i * 4] = static_cast<unsigned char>(16 + (i * 7) % 144);
+        c->mram[0xFE00 + i * 4 + 1] = static_cast<unsigned char>(8 + (i * 13) % 160);
+        c->mram[0xFE00 + i * 4 + 2] = static_cast<unsigned char>(i);
+        c->mram[0xFE00 + i * 4 + 3] = static_cast<unsigned char>((i & 3) << 5);
+    }
+
+    c->mram[0xFF40] = 0xF3;
+    c->mram[0xFF47] = 0xE4;
+    c->mram[0xFF48] = 0xE4;
+    c->mram[0xFF49] = 0x1B;
+    c->mram[0xFF4A] = 100;
+    c->mram[0xFF4B] = 87;
+
+    ppu* gpu = new ppu(c);
+
+    const unsigned int batch = 144;
+    run_bench("BM_ppu_scanline", batch, [&]() {
+        for (unsigned int i = 0; i < batch; i++) {
+            gpu->ly = i;
+            gpu->render_scanline();
+        }
+    });
+
+    auto run_frame = [&]() {
+        gpu->frame_ready = false;
+        while (!gpu->frame_ready) gpu->step(4);
+    };
+
+    run_bench("BM_ppu_frame/rendered", 1, run_frame);
+
+    gpu->render_enabled = false;
+    run_bench("BM_ppu_frame/skipped", 1, run_frame);
+
+    bench_scalers(gpu->framebuffer);
+
+    delete gpu;
+}
+
+static bool load_file(const char* path, vector<unsigned char>& out) {
+    std::ifstream in(path, std::ios_base::binary);
+    if (!in.is_open()) {
+        std::cerr << "Error: problem loading rom at " << path << endl;
+        return false;
+    }
+
+    out.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return true;
+}
+
+// Whole-ROM throughput: runs the cartridge from a fresh state one 70224-cycle frame at a time
+// and reports frames per second, with and without the profiler attached. The "unknown opcode"
+// print is turned off so it does not dominate the measurement.
+static void bench_rom(cpu* c, const char* path) {
+    vector<unsigned char> rom;
+    if (!load_file(path, rom)) return;
+
+    string name = path;
+    size_t slash = name.find_last_of("/\\");
+    if (slash != string::npos) name = name.substr(slash + 1);
+
+    const unsigned int frame_cycles = 70224;
+    ppu* gpu = new ppu(c);
+    profiler prof(static_cast<unsigned int>((rom.size() + 0x3FFF) / 0x4000));
+
+    auto run_frame = [&]() {
+        if (!c->running || c->prog_counter >= 0x8000) {
+            reset_cpu(c);
+            memcpy(c->mram, rom.data(), rom.size() < 0x8000 ? rom.size() : 0x8000);
+            c->prog_counter = 0x0100;
+            c->running = true;
+        }
+
+        unsigned long long end = c->cycles + frame_cycles;
+        while (c->cycles < end) {
+            c->read();
+            gpu->step(c->step_clocks);
+        }
+    };
+
+    c->report_unknown = false;
+    run_bench("BM_frame/" + name, 1, run_frame);
+
+    c->prof = &prof;
+    run_bench("BM_frame_profiled/" + name, 1, run_frame);
+    c->prof = nullptr;
+
+    // One displayed frame with --run-ahead 1: a real frame, a snapshot, a run-ahead frame and
+    // a restore.
+    cpu::state* snapshot = new cpu::state();
+    ppu::state ppu_snapshot;
+    run_bench("BM_frame_runahead1/" + name, 1, [&]() {
+        run_frame();
+        c->save_state(*snapshot);
+        gpu->save_state(ppu_snapshot);
+        run_frame();
+        c->load_state(*snapshot);
+        gpu->load_state(ppu_snapshot);
+    });
+    delete snapshot;
+    c->report_unknown = true;
+
+    delete gpu;
+}
+
+static void print_json() {
+    cout << std::dec << "{" << endl;
+    cout << "  \"context\": {" << endl;
+    cout << "    \"library_build_type\": \"" << (
+#ifdef NDEBUG
+        "release"
+#else
+        "debug"
+#endif
+    ) << "\"" << endl;
+    cout << "  }," << endl;
+    cout << "  \"benchmarks\": [" << endl;
+
+    for (size_t i = 0; i < results.size(); i++) {
+        bench_result& r = results[i];
+        cout << "    {" << endl;
+        cout << "      \"name\": \"" << r.name << "\"," << endl;
+        cout << "      \"run_name\": \"" << r.name << "\"," << endl;
+        cout << "      \"run_type\": \"iteration\"," << endl;
+        cout << "      \"iterations\": " << r.iterations << "," << endl;
+        cout << "      \"real_time\": " << r.ns_per_iter << "," << endl;
+        cout << "      \"cpu_time\": " << r.ns_per_iter << "," << endl;
+        cout << "      \"time_unit\": \"ns\"," << endl;
+        cout << "      \"items_per_second\": " << r.items_per_second << endl;
+        cout << "    }" << (i + 1 < results.size() ? "," : "") << endl;
+    }
+
+    cout << "  ]" << endl;
+    cout << "}" << endl;
+}
+
+static void print_console() {
+    cout << std::dec;
+    for (bench_result& r : results) {
+        cout << r.name;
+        for (size_t pad = r.name.size(); pad < 40; pad++) cout << ' ';
+        cout << r.ns_per_iter << " ns\t" << r.iterations << " iterations" << endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    bool json = true;
+    vector<const char*> roms;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--json") json = true;
+        else if (arg == "--console") json = false;
+        else if (arg == "--min-time" && i + 1 < argc) min_time = atof(argv[++i]);
+        else roms.push_back(argv[i]);
+    }
+
+    cpu* c = new cpu();
+
+    bench_opcodes(c);
+    bench_memory(c);
+    bench_ppu(c);
+    bench_state(c);
+    bench_ram_search(c);
+    for (const char* rom : roms) bench_rom(c, rom);
+
+    if (json) print_json();
+    else print_console();
+
+    delete c;
+    return 0;
+}
@@ -0,0 +1,376 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <cpu.h>
+
+using std::cout;
+using std::endl;
+using std::pair;
+using std::string;
+using std::vector;
+
+// Headless correctness gate for the interpreter. It runs two kinds of tests:
+//
+//   --json <dir>     every *.json file of the SingleStepTests sm83 vectors in dir. Each vector
+//                    sets up registers and RAM, executes one instruction and compares the result.
+//   --blargg <rom>   a Blargg test ROM (e.g. cpu_instrs/individual/01-special.gb), run until it
+//                    prints "Passed" or "Failed" over the serial port or --max-cycles elapses.
+//
+// Files are spread over --threads workers (default: all cores), each with its own cpu.
+//
+// Usage: cpu_tests [--threads N] [--max-cycles N] [--json dir] [--blargg rom ...]
+
+// Just enough JSON for the test vectors: objects, arrays, strings, numbers and literals.
+struct json {
+    enum kind_t { null_t, bool_t, number_t, string_t, array_t, object_t };
+
+    kind_t kind = null_t;
+    double number = 0;
+    string str;
+    vector<json> items;
+    vector<pair<string, json>> fields;
+
+    const json* get(const char* key) const {
+        for (const pair<string, json>& f : fields) {
+            if (f.first == key) return &f.second;
+        }
+        return nullptr;
+    }
+
+    unsigned int as_uint() const { return static_cast<unsigned int>(number); }
+};
+
+class json_parser {
+    public:
+        json_parser(const char* begin, const char* end) : p(begin), end(end) {}
+
+        bool parse(json& out) {
+            skip();
+            if (p >= end) return false;
+
+            switch (*p) {
+                case '{': return parse_object(out);
+                case '[': return parse_array(out);
+                case '"': out.kind = json::string_t; return parse_string(out.str);
+                case 't': out.kind = json::bool_t; out.number = 1; return literal("true");
+                case 'f': out.kind = json::bool_t; out.number = 0; return literal("false");
+                case 'n': out.kind = json::null_t; return literal("null");
+                default: {
+                    char* num_end;
+                    out.kind = json::number_t;
+                    out.number = strtod(p, &num_end);
+                    if (num_end == p) return false;
+                    p = num_end;
+                    return true;
+                }
+            }
+        }
+
+    private:
+        const char* p;
+        const char* end;
+
+        void skip() {
+            while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) p++;
+        }
+
+        bool literal(const char* word) {
+            size_t len = strlen(word);
+            if (static_cast<size_t>(end - p) < len || strncmp(p, word, len) != 0) return false;
+            p += len;
+            return true;
+        }
+
+        bool parse_string(string& out) {
+            p++;
+            while (p < end && *p != '"') {
+                if (*p == '\\' && p + 1 < end) p++;
+                out += *p++;
+            }
+            if (p >= end) return false;
+            p++;
+            return true;
+        }
+
+        bool parse_array(json& out) {
+            out.kind = json::array_t;
+            p++;
+            skip();
+            if (p < end && *p == ']') { p++; return true; }
+
+            while (true) {
+                out.items.emplace_back();
+                if (!parse(out.items.back())) return false;
+                skip();
+                if (p < end && *p == ',') { p++; continue; }
+                if (p < end && *p == ']') { p++; return true; }
+                return false;
+            }
+        }
+
+        bool parse_object(json& out) {
+            out.kind = json::object_t;
+            p++;
+            skip();
+            if (p < end && *p == '}') { p++; return true; }
+
+            while (true) {
+                skip();
+                out.fields.emplace_back();
+                if (p >= end || *p != '"' || !parse_string(out.fields.back().first)) return false;
+                skip();
+                if (p >= end || *p != ':') return false;
+                p++;
+                if (!parse(out.fields.back().second)) return false;
+                skip();
+                if (p < end && *p == ',') { p++; continue; }
+                if (p < end && *p == '}') { p++; return true; }
+                return false;
+            }
+        }
+};
+
+struct file_result {
+    string name;
+    unsigned int total = 0;
+    unsigned int passed = 0;
+    string first_failure;
+};
+
+static unsigned int field(const json& state, const char* key) {
+    const json* v = state.get(key);
+    return v ? v->as_uint() : 0;
+}
+
+// Each vector starts from a clean clock, so an OAM DMA started by the last one can't reach it.
+static void load_state(cpu* c, const json& state) {
+    c->reset();
+    c->prog_counter = field(state, "pc");
+    c->stack_pointer = field(state, "sp");
+    c->set_af(field(state, "a") << 8 | field(state, "f"));
+    c->set_bc(field(state, "b") << 8 | field(state, "c"));
+    c->set_de(field(state, "d") << 8 | field(state, "e"));
+    c->set_hl(field(state, "h") << 8 | field(state, "l"));
+
+    const json* ram = state.get("ram");
+    if (ram == nullptr) return;
+    for (const json& cell : ram->items) {
+        c->mram[cell.items[0].as_uint()] = static_cast<unsigned char>(cell.items[1].as_uint());
+    }
+}
+
+static void clear_ram(cpu* c, const json& state) {
+    const json* ram = state.get("ram");
+    if (ram == nullptr) return;
+    for (const json& cell : ram->items) c->mram[cell.items[0].as_uint()] = 0;
+}
+
+// Returns an empty string when the cpu matches state, otherwise a description of the first
+// difference.
+static string compare_state(cpu* c, const json& state, const json* cycles) {
+    std::ostringstream why;
+    why << std::hex;
+
+    const pair<const char*, unsigned int> regs[] = {
+        { "pc", c->prog_counter }, { "sp", c->stack_pointer },
+        { "a", c->registers.a }, { "f", c->registers.f },
+        { "b", c->registers.b }, { "c", c->registers.c },
+        { "d", c->registers.d }, { "e", c->registers.e },
+        { "h", c->registers.h }, { "l", c->registers.l },
+    };
+
+    for (const pair<const char*, unsigned int>& r : regs) {
+        if (state.get(r.first) && r.second != field(state, r.first)) {
+            why << r.first << " 0x" << r.second << " != 0x" << field(state, r.first);
+            return why.str();
+        }
+    }
+
+    const json* ram = state.get("ram");
+    if (ram != nullptr) {
+        for (const json& cell : ram->items) {
+            unsigned int addr = cell.items[0].as_uint();
+            if (c->mram[addr] != cell.items[1].as_uint()) {
+                why << "mram[0x" << addr << "] 0x" << static_cast<unsigned int>(c->mram[addr])
+                    << " != 0x" << cell.items[1].as_uint();
+                return why.str();
+            }
+        }
+    }
+
+    if (cycles != nullptr && c->step_cycles != cycles->items.size() * 4) {
+        why << std::dec << "cycles " << c->step_cycles << " != " << cycles->items.size() * 4;
+        return why.str();
+    }
+
+    return "";
+}
+
+static bool read_file(const string& path, string& out) {
+    std::ifstream in(path, std::ios_base::binary);
+    if (!in.is_open()) return false;
+
+    std::ostringstream buf;
+    buf << in.rdbuf();
+    out = buf.str();
+    return true;
+}
+
+static file_result run_json_file(cpu* c, const string& path) {
+    file_result result;
+    result.name = std::filesystem::path(path).filename().string();
+
+    string text;
+    json tests;
+    if (!read_file(path, text) || !json_parser(text.data(), text.data() + text.size()).parse(tests)) {
+        result.total = 1;
+        result.first_failure = "could not parse file";
+        return result;
+    }
+
+    for (const json& test : tests.items) {
+        const json* initial = test.get("initial");
+        const json* final_state = test.get("final");
+        if (initial == nullptr || final_state == nullptr) continue;
+
+        result.total++;
+        load_state(c, *initial);
+        c->read();
+
+        string why = compare_state(c, *final_state, test.get("cycles"));
+        if (why.empty()) {
+            result.passed++;
+        } else if (result.first_failure.empty()) {
+            const json* name = test.get("name");
+            result.first_failure = (name ? name->str : string("?")) + ": " + why;
+        }
+
+        clear_ram(c, *initial);
+        clear_ram(c, *final_state);
+    }
+
+    return result;
+}
+
+// Blargg's ROMs print their results over the link port: a byte is written to SB (0xFF01) and
+// a transfer is started by writing 0x81 to SC (0xFF02). Capturing it here keeps the test
+// independent of whether the core models the serial port.
+static file_result run_blargg(cpu* c, const string& path, unsigned long long max_cycles) {
+    file_result result;
+    result.name = std::filesystem::path(path).filename().string();
+    result.total = 1;
+
+    // The worker's cpu has run other jobs; start from a clean clock and no DMA window.
+    // load_rom() then sets the post-boot registers and PC at 0x0100.
+    c->reset();
+    memset(c->mram, 0, 0x10000);
+    if (!c->load_rom(path.c_str())) {
+        result.first_failure = "could not load rom";
+        return result;
+    }
+
+    string serial;
+    while (c->running && c->cycles < max_cycles) {
+        c->read();
+
+        if (c->mram[0xFF02] == 0x81) {
+            serial += static_cast<char>(c->mram[0xFF01]);
+            c->mram[0xFF02] = 0x01;
+
+            if (serial.find("Passed") != string::npos || serial.find("Failed") != string::npos) break;
+        }
+    }
+
+    if (serial.find("Passed") != string::npos) {
+        result.passed = 1;
+    } else {
+        std::replace(serial.begin(), serial.end(), '\n', ' ');
+        result.first_failure = serial.empty() ? "no serial output" : serial;
+    }
+
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    vector<string> json_files;
+    vector<string> blargg_roms;
+    unsigned int threads = std::thread::hardware_concurrency();
+    unsigned long long max_cycles = 4194304ull * 120;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (arg == "--max-cycles" && i + 1 < argc) max_cycles = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--blargg" && i + 1 < argc) blargg_roms.push_back(argv[++i]);
+        else if (arg == "--json" && i + 1 < argc) {
+            std::error_code ec;
+            for (const auto& entry : std::filesystem::directory_iterator(argv[++i], ec)) {
+                if (entry.path().extension() == ".json") json_files.push_back(entry.path().string());
+            }
+            if (ec) cout << "Error: problem reading test directory " << argv[i] << endl;
+        } else {
+            cout << "usage: cpu_tests [--threads N] [--max-cycles N] [--json dir] [--blargg rom ...]" << endl;
+            return -1;
+        }
+    }
+
+    std::sort(json_files.begin(), json_files.end());
+    if (threads == 0) threads = 1;
+
+    size_t job_count = json_files.size() + blargg_roms.size();
+    if (job_count == 0) {
+        cout << "Error: no tests found" << endl;
+        return -1;
+    }
+    vector<file_result> results(job_count);
+    std::atomic<size_t> next_job(0);
+
+    vector<std::thread> workers;
+    for (unsigned int t = 0; t < threads; t++) {
+        workers.emplace_back([&]() {
+            // Unimplemented opcodes are counted rather than printed, to keep the report readable.
+            cpu* c = new cpu();
+            c->report_unknown = false;
+            memset(c->mram, 0, 0x10000);
+
+            for (size_t job = next_job++; job < job_count; job = next_job++) {
+                if (job < json_files.size()) results[job] = run_json_file(c, json_files[job]);
+                else results[job] = run_blargg(c, blargg_roms[job - json_files.size()], max_cycles);
+            }
+
+            delete c;
+        });
+    }
+
+    for (std::thread& w : workers) w.join();
+
+    unsigned int files_passed = 0;
+    unsigned long long tests = 0;
+    unsigned long long tests_passed = 0;
+
+    for (const file_result& r : results) {
+        bool ok = r.passed == r.total;
+        files_passed += ok;
+        tests += r.total;
+        tests_passed += r.passed;
+
+        cout << (ok ? "PASS " : "FAIL ") << r.name << "  " << r.passed << "/" << r.total;
+        if (!ok) cout << "  " << r.first_failure;
+        cout << endl;
+    }
+
+    cout << endl << files_passed << "/" << results.size() << " files, "
+        << tests_passed << "/" << tests << " tests passed" << endl;
+
+    return files_passed == results.size() ? 0 : 1;
+}
\ No newline at end of file
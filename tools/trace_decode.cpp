@@ -0,0 +1,74 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <disasm.h>
+#include <trace.h>
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+// Decodes an execution trace written with --exec-trace, oldest record first.
+//
+// Usage: trace_decode <trace file> [--last N]
+
+int main(int argc, char* argv[]) {
+    const char* path = nullptr;
+    unsigned long long last = 0;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--last" && i + 1 < argc) last = strtoull(argv[++i], nullptr, 10);
+        else path = argv[i];
+    }
+
+    if (path == nullptr) {
+        cout << "usage: trace_decode <trace file> [--last N]" << endl;
+        return -1;
+    }
+
+    std::ifstream in(path, std::ios_base::binary);
+    if (!in.is_open()) {
+        cout << "Error: problem loading trace at " << path << endl;
+        return -1;
+    }
+
+    trace_header header;
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!in || memcmp(header.magic, "GBTRACE1", 8) != 0 || header.record_size != sizeof(trace_record)) {
+        cout << "Error: " << path << " is not a trace file" << endl;
+        return -1;
+    }
+
+    vector<trace_record> records(header.capacity);
+    in.read(reinterpret_cast<char*>(records.data()), records.size() * sizeof(trace_record));
+
+    unsigned long long count = header.head < header.capacity ? header.head : header.capacity;
+    if (last != 0 && last < count) count = last;
+
+    char line[160];
+    for (unsigned long long i = header.head - count; i < header.head; i++) {
+        const trace_record& r = records[i % header.capacity];
+        unsigned char bytes[3] = { r.opcode, r.operand[0], r.operand[1] };
+        unsigned int length = instruction_length(bytes);
+
+        char hex_bytes[12] = "";
+        for (unsigned int b = 0; b < length; b++) {
+            snprintf(hex_bytes + b * 3, 4, "%02X ", bytes[b]);
+        }
+
+        snprintf(line, sizeof(line),
+            "%12llu  %02X:%04X  %-9s %-20s A:%02X F:%02X B:%02X C:%02X D:%02X E:%02X H:%02X L:%02X SP:%04X",
+            r.cycle, r.bank, r.pc, hex_bytes, disassemble(r.pc, bytes).c_str(),
+            r.a, r.f, r.b, r.c, r.d, r.e, r.h, r.l, r.sp);
+        cout << line << "\n";
+    }
+
+    return 0;
+}
\ No newline at end of file